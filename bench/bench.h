@@ -0,0 +1,27 @@
+#ifndef STREM_BENCH_BENCH_H_
+#define STREM_BENCH_BENCH_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Wall clock seconds, C11 only, so benches build without POSIX headers
+static inline double bench_seconds(void) {
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// splitmix64, so runs are repeatable and rand() isn't the bottleneck
+static inline uint64_t bench_random(uint64_t* state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// Optional numeric argument i of main, fallback if it's absent
+static inline size_t bench_arg(int argc, char** argv, int i, size_t fallback) {
+	return argc > i ? (size_t)strtoull(argv[i], NULL, 10) : fallback;
+}
+
+#endif // STREM_BENCH_BENCH_H_
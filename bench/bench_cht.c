@@ -0,0 +1,124 @@
+// Concurrent table throughput from 1 to max threads on a mix of lookups and writes
+// (inserts and removes in equal numbers, so size stays put), single-threaded
+// StremHashTable on the same mix for reference. Build with -O2, run on an idle machine.
+// Build: cc -std=c11 -O2 -I.. bench_cht.c ../strem_*.c -lpthread && ./a.out [keys] [ops per thread] [max threads] [read %]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "strem_cht.h"
+#include "bench.h"
+
+typedef struct {
+	StremConcurrentHashTable* cht;
+	size_t keys;
+	size_t ops;
+	unsigned read_percent;
+	uint64_t seed;
+	uint64_t found;
+} Worker;
+
+// Keys are 0 to 2 * keys, so about half of lookups hit
+static void* work(void* arg) {
+	Worker* const worker = arg;
+	uint64_t state = worker->seed;
+	for(size_t op = 0; op < worker->ops; op++) {
+		const uint64_t r = bench_random(&state);
+		const uint64_t key = (r >> 8) % (worker->keys * 2);
+		if(r % 100 < worker->read_percent) {
+			uint64_t value;
+			worker->found += StremConcurrentHashTable_at(worker->cht, &key, &value);
+		} else if(r & 128) {
+			bool inserted;
+			StremConcurrentHashTable_insert(worker->cht, &key, &key, &inserted);
+		} else {
+			StremConcurrentHashTable_remove(worker->cht, &key, NULL);
+		}
+	}
+	return NULL;
+}
+
+static double run_cht(size_t threads, size_t keys, size_t ops, unsigned read_percent) {
+	static StremConcurrentHashTable cht;
+	if(!StremConcurrentHashTable_construct(&cht, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL)) {
+		return 0;
+	}
+	for(uint64_t key = 0; key < keys * 2; key += 2) {
+		bool inserted;
+		StremConcurrentHashTable_insert(&cht, &key, &key, &inserted);
+	}
+
+	Worker* const workers = calloc(threads, sizeof(Worker));
+	pthread_t* const ids = calloc(threads, sizeof(pthread_t));
+	if(workers == NULL || ids == NULL) {
+		free(workers);
+		free(ids);
+		StremConcurrentHashTable_free(&cht);
+		return 0;
+	}
+	const double start = bench_seconds();
+	size_t started = 0;
+	for(; started < threads; started++) {
+		workers[started] = (Worker){ &cht, keys, ops, read_percent, started + 1, 0 };
+		if(pthread_create(&ids[started], NULL, work, &workers[started]) != 0) {
+			break;
+		}
+	}
+	for(size_t t = 0; t < started; t++) {
+		pthread_join(ids[t], NULL);
+	}
+	const double elapsed = bench_seconds() - start;
+
+	free(workers);
+	free(ids);
+	StremConcurrentHashTable_free(&cht);
+	return (double)(started * ops) / elapsed * 1e-6;
+}
+
+static double run_single(size_t keys, size_t ops, unsigned read_percent) {
+	StremHashTable ht = StremHashTable_construct(sizeof(uint64_t), sizeof(uint64_t), NULL, NULL);
+	if(ht.keys.content == NULL) {
+		return 0;
+	}
+	for(uint64_t key = 0; key < keys * 2; key += 2) {
+		StremHashTable_insert(&ht, &key, &key);
+	}
+
+	uint64_t state = 1;
+	const double start = bench_seconds();
+	for(size_t op = 0; op < ops; op++) {
+		const uint64_t r = bench_random(&state);
+		const uint64_t key = (r >> 8) % (keys * 2);
+		if(r % 100 < read_percent) {
+			StremHashTable_at(&ht, &key);
+		} else if(r & 128) {
+			StremHashTable_upsert(&ht, &key, &key, NULL);
+		} else {
+			StremHashTable_remove(&ht, &key);
+		}
+	}
+	const double elapsed = bench_seconds() - start;
+
+	StremHashTable_free(&ht);
+	return (double)ops / elapsed * 1e-6;
+}
+
+int main(int argc, char** argv) {
+	const size_t keys = bench_arg(argc, argv, 1, (size_t)1 << 20);
+	const size_t ops = bench_arg(argc, argv, 2, (size_t)1 << 21);
+	const size_t max_threads = bench_arg(argc, argv, 3, 64);
+	const unsigned read_percent = (unsigned)bench_arg(argc, argv, 4, 90);
+	if(keys == 0 || read_percent > 100) {
+		fprintf(stderr, "usage: %s [keys > 0] [ops per thread] [max threads] [read %% <= 100]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu keys, %zu ops per thread, %u%% lookups, million ops per second\n", keys, ops, read_percent);
+	printf("%-22s %10.2f\n", "StremHashTable 1", run_single(keys, ops, read_percent));
+	for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+		char name[32];
+		snprintf(name, sizeof(name), "concurrent %zu", threads);
+		printf("%-22s %10.2f\n", name, run_cht(threads, keys, ops, read_percent));
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+// Built-in hash and equality kernels against a naive byte loop (h = h * 31 + byte,
+// compared byte by byte), per key size: hashing speed, then a set of sequential keys
+// with fastrange index (high hash bits) and adjacent probing, where a weak hash shows
+// up as long probes. Key size without a kernel (24) uses StremHash_bytes and memcmp.
+// Build: cc -std=c11 -O2 -I.. bench_hash.c ../strem_*.c -lpthread && ./a.out [keys]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_hs.h"
+#include "bench.h"
+
+#define GIVE_UP_SECONDS 2.0
+
+static size_t key_size; /* of naive kernels, they take no length */
+
+static size_t naive_hash(void const* key) {
+	unsigned char const* const bytes = key;
+	size_t hash = 0;
+	for(size_t i = 0; i < key_size; i++) {
+		hash = hash * 31 + bytes[i];
+	}
+	return hash;
+}
+
+static bool naive_cmp(void const* a, void const* b) {
+	unsigned char const* const x = a;
+	unsigned char const* const y = b;
+	for(size_t i = 0; i < key_size; i++) {
+		if(x[i] != y[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static size_t builtin_hash(void const* key) {
+	return StremHash_bytes(key, key_size);
+}
+
+// Key i holds i in its first bytes, the rest are zeros
+static void fill_keys(unsigned char* keys, size_t count) {
+	memset(keys, 0, count * key_size);
+	for(size_t i = 0; i < count; i++) {
+		const uint64_t value = i;
+		memcpy(keys + i * key_size, &value, key_size < sizeof(value) ? key_size : sizeof(value));
+	}
+}
+
+static void run(char const* name, StremHashFunction func, StremCmpFunction cmp_func, unsigned char* keys, size_t count) {
+	/* hashing alone, summed so it isn't optimized out */
+	StremHashFunction const hash = func != NULL ? func
+		: StremHash_for_size(key_size) != NULL ? StremHash_for_size(key_size) : builtin_hash;
+	size_t sum = 0;
+	double start = bench_seconds();
+	for(size_t i = 0; i < count; i++) {
+		sum += hash(keys + i * key_size);
+	}
+	const double hashing = bench_seconds() - start;
+
+	StremHashSet hs = StremHashSet_construct_policy(
+		key_size, func, cmp_func, STREM_HS_LINEAR, STREM_INDEX_FASTRANGE, STREM_SEQ_LINEAR
+	);
+	if(hs.keys == NULL) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return;
+	}
+	/* probes of a bad enough hash grow with size, so inserting stops after a while */
+	size_t inserted = 0;
+	start = bench_seconds();
+	for(; inserted < count; inserted++) {
+		if(inserted % 1024 == 0 && bench_seconds() - start > GIVE_UP_SECONDS) {
+			break;
+		}
+		StremHashSet_insert(&hs, keys + inserted * key_size);
+	}
+	const double inserts = bench_seconds() - start;
+
+	size_t found = 0;
+	start = bench_seconds();
+	for(size_t i = 0; i < inserted; i++) {
+		found += StremHashSet_at(&hs, keys + i * key_size) != NULL;
+	}
+	const double lookups = bench_seconds() - start;
+
+	const StremHashStats stats = StremHashSet_stats(&hs);
+	printf("%4zu %-9s %9.2f %9.1f %9.1f %10.2f %9zu",
+		key_size, name, hashing * 1e9 / (double)count, inserts * 1e9 / (double)inserted,
+		lookups * 1e9 / (double)inserted, stats.avg_probe, stats.max_probe
+	);
+	if(inserted < count) {
+		printf("  gave up after %zu keys", inserted);
+	}
+	puts(found == inserted || sum == 1 ? "" : "  lost keys");
+	StremHashSet_free(&hs);
+}
+
+int main(int argc, char** argv) {
+	const size_t count = bench_arg(argc, argv, 1, (size_t)1 << 18);
+	static const size_t sizes[] = { 4, 8, 16, 24, 32, 64 };
+	unsigned char* const keys = malloc(count * 64);
+	if(count == 0 || keys == NULL) {
+		fprintf(stderr, "usage: %s [keys > 0]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu sequential keys, ns per key\n", count);
+	printf("%4s %-9s %9s %9s %9s %10s %9s\n", "size", "kernel", "hash", "insert", "lookup", "avg probe", "max probe");
+	for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		key_size = sizes[s];
+		fill_keys(keys, count);
+		run("built-in", NULL, NULL, keys, count);
+		run("naive", naive_hash, naive_cmp, keys, count);
+	}
+	free(keys);
+	return 0;
+}
@@ -0,0 +1,62 @@
+// Insert latency with growth done at once against STREM_HT_INCREMENTAL, which moves
+// old slots a few at a time. Every insert is timed, percentiles show the resize stalls.
+// Build: cc -std=c11 -O2 -I.. bench_incremental.c ../strem_*.c -lpthread && ./a.out [keys]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "strem_ht.h"
+#include "bench.h"
+
+static int cmp_latency(void const* a, void const* b) {
+	const float x = *(float const*)a;
+	const float y = *(float const*)b;
+	return (x > y) - (x < y);
+}
+
+static void run(char const* name, int mode, float* latencies, size_t keys) {
+	StremHashTable ht = StremHashTable_construct_mode(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, (StremHTMode)mode
+	);
+	if(ht.keys.content == NULL) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return;
+	}
+
+	uint64_t state = 1;
+	const double start = bench_seconds();
+	for(size_t i = 0; i < keys; i++) {
+		const uint64_t key = bench_random(&state);
+		const double before = bench_seconds();
+		StremHashTable_insert(&ht, &key, &key);
+		latencies[i] = (float)((bench_seconds() - before) * 1e9);
+	}
+	const double total = bench_seconds() - start;
+
+	qsort(latencies, keys, sizeof(float), cmp_latency);
+	printf("%-12s %10.1f %10.0f %10.0f %10.0f %12.0f %12.0f\n",
+		name, total * 1e9 / (double)keys,
+		latencies[keys / 2], latencies[keys / 100 * 99], latencies[keys / 1000 * 999],
+		latencies[keys - keys / 1000000 - 1], latencies[keys - 1]
+	);
+	StremHashTable_free(&ht);
+}
+
+int main(int argc, char** argv) {
+	const size_t keys = bench_arg(argc, argv, 1, (size_t)1 << 22);
+	float* const latencies = malloc(keys * sizeof(float));
+	if(keys == 0 || latencies == NULL) {
+		fprintf(stderr, "usage: %s [keys > 0]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu inserts, ns (timing itself adds a few tens of ns)\n", keys);
+	printf("%-12s %10s %10s %10s %10s %12s %12s\n", "mode", "mean", "p50", "p99", "p99.9", "p99.9999", "max");
+	run("linear", STREM_HT_LINEAR, latencies, keys);
+	run("linear inc", STREM_HT_LINEAR | STREM_HT_INCREMENTAL, latencies, keys);
+	run("group", STREM_HT_GROUP, latencies, keys);
+	run("group inc", STREM_HT_GROUP | STREM_HT_INCREMENTAL, latencies, keys);
+	run("robin hood", STREM_HT_ROBIN_HOOD, latencies, keys);
+	run("rh inc", STREM_HT_ROBIN_HOOD | STREM_HT_INCREMENTAL, latencies, keys);
+	free(latencies);
+	return 0;
+}
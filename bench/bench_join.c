@@ -0,0 +1,136 @@
+// Partitioned group-by and hash join on synthetic uniform and Zipf keys, 1 to max threads.
+// Group-by counts rows per key, join probes as many rows again drawn the same way.
+// Rows are held in memory, 20 bytes each with probes, so 1e9 rows take about 20 GB.
+// Build: cc -std=c11 -O2 -I.. bench_join.c ../strem_*.c -lpthread -lm && ./a.out [rows] [distinct keys] [max threads] [zipf exponent x100]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "strem_join.h"
+#include "bench.h"
+
+#define MAX_THREADS 64
+
+// Matches counted per thread, a line apart, so threads don't share one
+typedef struct {
+	uint64_t matches;
+	char pad[64 - sizeof(uint64_t)];
+} Counter;
+
+static void add_count(void* existing, void const* value) {
+	*(uint32_t*)existing += *(uint32_t const*)value;
+}
+
+static void count_match(void* ctx, size_t thread, size_t row, void* value) {
+	(void)row;
+	(void)value;
+	Counter* const counters = ctx;
+	counters[thread].matches++;
+}
+
+// Key of rank r (from 0) has weight 1 / (r + 1)^exponent; exponent 0 is uniform.
+// Ranks are scattered over key space, so hot keys don't share partitions.
+static void fill_keys(uint64_t* keys, size_t rows, size_t distinct, double exponent, uint64_t seed) {
+	uint64_t state = seed;
+	if(exponent == 0) {
+		for(size_t i = 0; i < rows; i++) {
+			keys[i] = (bench_random(&state) % distinct) * 0x9E3779B97F4A7C15ull;
+		}
+		return;
+	}
+
+	double* const cdf = malloc(distinct * sizeof(double));
+	if(cdf == NULL) {
+		fprintf(stderr, "out of memory for Zipf table\n");
+		exit(1);
+	}
+	double sum = 0;
+	for(size_t r = 0; r < distinct; r++) {
+		sum += 1.0 / pow((double)(r + 1), exponent);
+		cdf[r] = sum;
+	}
+	for(size_t i = 0; i < rows; i++) {
+		const double u = (double)(bench_random(&state) >> 11) * 0x1.0p-53 * sum;
+		size_t lo = 0;
+		size_t hi = distinct - 1;
+		while(lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+			if(cdf[mid] < u) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		keys[i] = (uint64_t)lo * 0x9E3779B97F4A7C15ull;
+	}
+	free(cdf);
+}
+
+static void run(
+	char const* name, uint64_t* keys, uint64_t* probes, uint32_t* ones, size_t rows, size_t max_threads
+) {
+	static Counter counters[MAX_THREADS];
+
+	for(size_t threads = 1; threads <= max_threads; threads *= 2) {
+		StremPartitionedTable pt;
+		double start = bench_seconds();
+		if(!StremPartitionedTable_group_by(
+			&pt, keys, ones, rows, sizeof(uint64_t), sizeof(uint32_t), NULL, NULL, add_count, threads
+		)) {
+			fprintf(stderr, "%s: out of memory\n", name);
+			return;
+		}
+		const double group_by = bench_seconds() - start;
+
+		for(size_t t = 0; t < MAX_THREADS; t++) {
+			counters[t].matches = 0;
+		}
+		start = bench_seconds();
+		const bool joined = StremPartitionedTable_join(&pt, probes, rows, count_match, counters, threads);
+		const double join = bench_seconds() - start;
+		uint64_t matches = 0;
+		for(size_t t = 0; t < MAX_THREADS; t++) {
+			matches += counters[t].matches;
+		}
+
+		printf("%-8s %7zu %14.1f %14.1f %14llu\n",
+			name, threads, (double)rows / group_by * 1e-6,
+			joined ? (double)rows / join * 1e-6 : 0.0, (unsigned long long)matches
+		);
+		StremPartitionedTable_free(&pt);
+	}
+}
+
+int main(int argc, char** argv) {
+	const size_t rows = bench_arg(argc, argv, 1, (size_t)1 << 24);
+	const size_t distinct = bench_arg(argc, argv, 2, (size_t)1 << 20);
+	size_t max_threads = bench_arg(argc, argv, 3, MAX_THREADS);
+	const double exponent = (double)bench_arg(argc, argv, 4, 100) / 100;
+	max_threads = max_threads < MAX_THREADS ? max_threads : MAX_THREADS;
+
+	uint64_t* const keys = malloc(rows * sizeof(uint64_t));
+	uint64_t* const probes = malloc(rows * sizeof(uint64_t));
+	uint32_t* const ones = malloc(rows * sizeof(uint32_t));
+	if(rows == 0 || distinct == 0 || keys == NULL || probes == NULL || ones == NULL) {
+		fprintf(stderr, "usage: %s [rows > 0] [distinct keys > 0] [max threads] [zipf exponent x100]\n", argv[0]);
+		return 1;
+	}
+	for(size_t i = 0; i < rows; i++) {
+		ones[i] = 1;
+	}
+
+	printf("%zu rows, %zu distinct keys, million rows per second\n", rows, distinct);
+	printf("%-8s %7s %14s %14s %14s\n", "keys", "threads", "group-by", "join", "matches");
+	/* probe keys come from twice the key space, so about half of them miss */
+	fill_keys(keys, rows, distinct, 0, 1);
+	fill_keys(probes, rows, distinct * 2, 0, 2);
+	run("uniform", keys, probes, ones, rows, max_threads);
+	fill_keys(keys, rows, distinct, exponent, 1);
+	fill_keys(probes, rows, distinct * 2, exponent, 2);
+	run("zipf", keys, probes, ones, rows, max_threads);
+
+	free(keys);
+	free(probes);
+	free(ones);
+	return 0;
+}
@@ -0,0 +1,75 @@
+// Robin hood against linear (gap) and group probing under churn: as many removes as inserts
+// at steady size, then hit and miss lookups. Reports time per operation and probe lengths.
+// Build: cc -std=c11 -O2 -I.. bench_probing.c ../strem_*.c -lpthread && ./a.out [keys] [churn ops]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "strem_ht.h"
+#include "bench.h"
+
+static void run(char const* name, StremHTMode mode, uint64_t* live, size_t keys, size_t ops) {
+	StremHashTable ht = StremHashTable_construct_mode(sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, mode);
+	if(ht.keys.content == NULL) {
+		fprintf(stderr, "%s: out of memory\n", name);
+		return;
+	}
+	uint64_t state = 1;
+	for(size_t i = 0; i < keys; i++) {
+		live[i] = bench_random(&state);
+		StremHashTable_insert(&ht, &live[i], &live[i]);
+	}
+
+	/* key removed is picked at random, the new one takes its place in live */
+	double start = bench_seconds();
+	for(size_t op = 0; op < ops; op++) {
+		const size_t i = (size_t)(bench_random(&state) % keys);
+		StremHashTable_remove(&ht, &live[i]);
+		live[i] = bench_random(&state);
+		StremHashTable_insert(&ht, &live[i], &live[i]);
+	}
+	const double churn = bench_seconds() - start;
+
+	uint64_t found = 0;
+	start = bench_seconds();
+	for(size_t i = 0; i < keys; i++) {
+		found += StremHashTable_at(&ht, &live[i]) != NULL;
+	}
+	const double hits = bench_seconds() - start;
+
+	start = bench_seconds();
+	for(size_t i = 0; i < keys; i++) {
+		const uint64_t missing = bench_random(&state);
+		found += StremHashTable_at(&ht, &missing) != NULL;
+	}
+	const double misses = bench_seconds() - start;
+
+	const StremHashStats stats = StremHashTable_stats(&ht);
+	printf("%-11s %10.1f %10.1f %10.1f %10.2f %9zu %11zu %11zu\n",
+		name, churn * 1e9 / (double)ops, hits * 1e9 / (double)keys, misses * 1e9 / (double)keys,
+		stats.avg_probe, stats.max_probe, stats.tombstones, stats.cap
+	);
+	if(found != keys) {
+		fprintf(stderr, "%s: found %llu of %zu keys\n", name, (unsigned long long)found, keys);
+	}
+	StremHashTable_free(&ht);
+}
+
+int main(int argc, char** argv) {
+	const size_t keys = bench_arg(argc, argv, 1, (size_t)1 << 20);
+	const size_t ops = bench_arg(argc, argv, 2, keys * 4);
+	uint64_t* const live = malloc(keys * sizeof(uint64_t));
+	if(keys == 0 || live == NULL) {
+		fprintf(stderr, "usage: %s [keys > 0] [churn ops]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu keys, %zu churn ops (remove + insert), ns per op\n", keys, ops);
+	printf("%-11s %10s %10s %10s %10s %9s %11s %11s\n",
+		"mode", "churn", "hit", "miss", "avg probe", "max probe", "tombstones", "cap"
+	);
+	run("linear", STREM_HT_LINEAR, live, keys, ops);
+	run("group", STREM_HT_GROUP, live, keys, ops);
+	run("robin hood", STREM_HT_ROBIN_HOOD, live, keys, ops);
+	free(live);
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include "strem_alloc.h"
+
+// TLSF keeps flags in low bits of sizes, so they must be multiples of two pointers
+static size_t tlsf_size(size_t size) {
+	const size_t align = 2 * sizeof(void*);
+	return size != 0 ? (size + align - 1) / align * align : align;
+}
+
+static void* tlsf_alloc(void* ctx, size_t size) {
+	return StremTLSF_alloc(ctx, tlsf_size(size));
+}
+
+static void* tlsf_realloc(void* ctx, void* ptr, size_t size) {
+	return StremTLSF_realloc(ctx, ptr, tlsf_size(size));
+}
+
+static void tlsf_free(void* ctx, void* ptr) {
+	StremTLSF_free(ctx, ptr);
+}
+
+StremAllocator StremAllocator_tlsf(StremTLSF* tlsf) {
+	return (StremAllocator){ tlsf_alloc, tlsf_realloc, tlsf_free, tlsf };
+}
+
+// Pool keeps free chain in contents, so they must fit a pointer
+static size_t pool_size(size_t size) {
+	if(size < sizeof(void*)) {
+		size = sizeof(void*);
+	}
+	return (size + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t);
+}
+
+static void* pool_alloc(void* ctx, size_t size) {
+	return StremMemPool_alloc(ctx, pool_size(size));
+}
+
+// StremMemPool_realloc frees the segment before allocating and splits inside contents
+// not yet moved, so growing always allocates, copies and then frees
+static void* pool_realloc(void* ctx, void* ptr, size_t size) {
+	StremMemPool_Seg const* const seg = (StremMemPool_Seg const*)((char*)ptr - sizeof(StremMemPool_Seg));
+	const size_t new_size = pool_size(size);
+
+	if(new_size == seg->size) {
+		return ptr;
+	}
+	void* const moved = StremMemPool_alloc(ctx, new_size);
+	if(moved == NULL) {
+		return NULL;
+	}
+	memcpy(moved, ptr, seg->size < new_size ? seg->size : new_size);
+	StremMemPool_free(ctx, &ptr, 1);
+	return moved;
+}
+
+static void pool_free(void* ctx, void* ptr) {
+	StremMemPool_free(ctx, &ptr, 1);
+}
+
+StremAllocator StremAllocator_mem_pool(StremMemPool* pool) {
+	return (StremAllocator){ pool_alloc, pool_realloc, pool_free, pool };
+}
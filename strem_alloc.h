@@ -0,0 +1,61 @@
+#ifndef STREM_ALLOC_H_
+#define STREM_ALLOC_H_
+#include <stdlib.h>
+#include <string.h>
+#include "strem_common.h"
+#include "strem_tlsf.h"
+#include "strem_mem_pool.h"
+
+// Memory source of containers. Every call gets ctx as its first argument.
+// realloc keeps contents like realloc(3) does, possibly moving them.
+// Containers keep a pointer to allocator, which must outlive them;
+// NULL stands for malloc/realloc/free.
+typedef struct {
+	void* (*alloc)(void* ctx, size_t size);
+	void* (*realloc)(void* ctx, void* ptr, size_t size);
+	void (*free)(void* ctx, void* ptr);
+	void* ctx;
+} StremAllocator;
+
+static inline void* StremAllocator_alloc(StremAllocator const* a, size_t size) {
+	return a != NULL ? a->alloc(a->ctx, size) : malloc(size);
+}
+
+// NULL if count * size overflows, like calloc(3)
+static inline void* StremAllocator_calloc(StremAllocator const* a, size_t count, size_t size) {
+	if(a == NULL) {
+		return calloc(count, size);
+	}
+	if(count != 0 && size > STREM_SIZE_MAX / count) {
+		return NULL;
+	}
+	void* const ptr = a->alloc(a->ctx, count * size);
+	if(ptr != NULL) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+
+// ptr may be NULL
+static inline void* StremAllocator_realloc(StremAllocator const* a, void* ptr, size_t size) {
+	if(a == NULL) {
+		return realloc(ptr, size);
+	}
+	return ptr != NULL ? a->realloc(a->ctx, ptr, size) : a->alloc(a->ctx, size);
+}
+
+// ptr may be NULL
+static inline void StremAllocator_free(StremAllocator const* a, void* ptr) {
+	if(a == NULL) {
+		free(ptr);
+	} else if(ptr != NULL) {
+		a->free(a->ctx, ptr);
+	}
+}
+
+// Adapters allocating from the given allocator, which must outlive the returned one
+StremAllocator StremAllocator_tlsf(StremTLSF* tlsf);
+// Sizes are rounded up to sizeof(size_t) as the pool requires
+StremAllocator StremAllocator_mem_pool(StremMemPool* pool);
+
+#endif // STREM_ALLOC_H_
@@ -0,0 +1,61 @@
+#ifndef STREM_BLOOM_H_
+#define STREM_BLOOM_H_
+#include <stdint.h>
+#include "strem_common.h"
+#include "strem_index.h"
+
+// Blocked Bloom filter: every key sets one bit in each word of a single
+// cache-line block, so a lookup touches one cache line.
+// Bits are derived from the mixed hash, independent of home slot index.
+
+#define STREM_BLOOM_WORDS 8
+// Filter bits per slot of the set, 16 bits per key at saturation 0.5
+#define STREM_BLOOM_BITS_PER_SLOT 8
+
+typedef struct {
+	uint64_t words[STREM_BLOOM_WORDS];
+} StremBloomBlock;
+
+static inline size_t StremBloom_blocks(size_t cap) {
+	const size_t blocks = cap * STREM_BLOOM_BITS_PER_SLOT / (sizeof(StremBloomBlock) * 8);
+	return blocks != 0 ? blocks : 1;
+}
+
+static inline StremBloomBlock* StremBloom_block(StremBloomBlock* bloom, size_t blocks, size_t hash) {
+	return &bloom[StremIndex_home(StremIndex_mix(hash), blocks, STREM_INDEX_FASTRANGE)];
+}
+
+// Bit of i-th word: odd multipliers spread low half of mixed hash to 6 top bits
+static inline uint64_t StremBloom_bit(size_t hash, size_t i) {
+	static const uint32_t salt[STREM_BLOOM_WORDS] = {
+		0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+		0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u,
+	};
+	const uint32_t h = (uint32_t)StremIndex_mix(hash);
+	return (uint64_t)1 << ((h * salt[i]) >> 26);
+}
+
+static inline void StremBloom_add(StremBloomBlock* block, size_t hash) {
+	for(size_t i = 0; i < STREM_BLOOM_WORDS; i++) {
+		block->words[i] |= StremBloom_bit(hash, i);
+	}
+}
+
+// Same as StremBloom_add, may be called by many threads at once
+static inline void StremBloom_add_atomic(StremBloomBlock* block, size_t hash) {
+	for(size_t i = 0; i < STREM_BLOOM_WORDS; i++) {
+		__atomic_fetch_or(&block->words[i], StremBloom_bit(hash, i), __ATOMIC_RELAXED);
+	}
+}
+
+// False means no key with such hash was added
+static inline bool StremBloom_may_contain(StremBloomBlock const* block, size_t hash) {
+	uint64_t missing = 0;
+	for(size_t i = 0; i < STREM_BLOOM_WORDS; i++) {
+		const uint64_t bit = StremBloom_bit(hash, i);
+		missing |= (block->words[i] & bit) ^ bit;
+	}
+	return missing == 0;
+}
+
+#endif // STREM_BLOOM_H_
@@ -0,0 +1,168 @@
+#include <string.h>
+#include <assert.h>
+#include "strem_cache.h"
+
+#define KEYSPAN(c) (((c).key_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*))
+#define NODESIZE(c) (sizeof(StremCacheNode) + KEYSPAN(c) + (c).value_size)
+
+static char* value_of(StremCache* cache, StremCacheNode* node) {
+	return node->content + KEYSPAN(*cache);
+}
+
+// Puts node before head of the circular list: for LRU it becomes head,
+// for CLOCK it's the last one the hand reaches
+static void link(StremCache* cache, StremCacheNode* node) {
+	StremCacheNode* const head = cache->head;
+
+	if(head == NULL) {
+		node->prev = node->next = node;
+		cache->head = node;
+		return;
+	}
+	node->next = head;
+	node->prev = head->prev;
+	head->prev->next = node;
+	head->prev = node;
+	if(cache->mode == STREM_CACHE_LRU) {
+		cache->head = node;
+	}
+}
+
+static void unlink_node(StremCache* cache, StremCacheNode* node) {
+	if(node->next == node) {
+		cache->head = NULL;
+		return;
+	}
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	if(cache->head == node) {
+		cache->head = node->next;
+	}
+}
+
+static void touch(StremCache* cache, StremCacheNode* node) {
+	if(cache->mode == STREM_CACHE_CLOCK) {
+		/* no write if marked already, so hot entries stay clean in cache */
+		if(!node->referenced) {
+			node->referenced = 1;
+		}
+	} else if(cache->head != node) {
+		unlink_node(cache, node);
+		link(cache, node);
+	}
+}
+
+static void evict(StremCache* cache) {
+	StremCacheNode* victim;
+
+	if(cache->mode == STREM_CACHE_CLOCK) {
+		while(cache->head->referenced) {
+			cache->head->referenced = 0;
+			cache->head = cache->head->next;
+		}
+		victim = cache->head;
+	} else {
+		victim = cache->head->prev;
+	}
+
+	unlink_node(cache, victim);
+	StremHashTable_remove(&cache->table, victim->content);
+	cache->evictions++;
+}
+
+StremCache StremCache_construct(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	size_t capacity,
+	StremCacheMode mode
+) {
+	return StremCache_construct_with(key_size, value_size, func, cmp_func, capacity, mode, NULL);
+}
+
+StremCache StremCache_construct_with(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	size_t capacity,
+	StremCacheMode mode,
+	StremAllocator const* allocator
+) {
+	assert(capacity != 0 && "Cache must fit at least one entry");
+	StremCache cache = { 0 };
+
+	cache.capacity = capacity;
+	cache.key_size = key_size;
+	cache.value_size = value_size;
+	cache.mode = (int)mode;
+	cache.table = StremHashTable_construct_with(
+		key_size, NODESIZE(cache), func, cmp_func,
+		STREM_HT_ROBIN_HOOD, STREM_INDEX_MASK, STREM_SEQ_LINEAR, allocator
+	);
+	if(cache.table.keys.content == NULL) {
+		return cache;
+	}
+
+	/* capacity + 1 keys stay under saturation: put inserts before it evicts */
+	size_t cap = cache.table.keys.capacity_elems;
+	while((float)(capacity + 1) >= cap * cache.table.saturation) {
+		cap *= 2;
+	}
+	StremHashTable_resize(&cache.table, cap);
+	if(cache.table.keys.capacity_elems != cap) {
+		StremHashTable_free(&cache.table);
+	}
+	return cache;
+}
+
+void StremCache_free(StremCache* cache) {
+	StremHashTable_free(&cache->table);
+	cache->head = NULL;
+}
+
+void* StremCache_get(StremCache* cache, void const* key) {
+	StremCacheNode* const node = StremHashTable_at(&cache->table, key);
+
+	if(node == NULL) {
+		cache->misses++;
+		return NULL;
+	}
+	cache->hits++;
+	touch(cache, node);
+	return value_of(cache, node);
+}
+
+void* StremCache_put(StremCache* cache, void const* key, void const* value) {
+	bool inserted;
+	StremCacheNode* const node = StremHashTable_find_or_insert(&cache->table, key, &inserted);
+
+	if(node == NULL) {
+		return NULL;
+	}
+	if(inserted) {
+		memcpy(node->content, key, cache->key_size);
+		node->referenced = 0;
+		if(cache->table.keys.size > cache->capacity) {
+			evict(cache);
+		}
+		link(cache, node);
+	} else {
+		touch(cache, node);
+	}
+
+	memcpy(value_of(cache, node), value, cache->value_size);
+	return value_of(cache, node);
+}
+
+bool StremCache_remove(StremCache* cache, void const* key) {
+	StremCacheNode* const node = StremHashTable_at(&cache->table, key);
+
+	if(node == NULL) {
+		return false;
+	}
+	unlink_node(cache, node);
+	StremHashTable_remove(&cache->table, key);
+	return true;
+}
@@ -0,0 +1,73 @@
+#ifndef STREM_CACHE_H_
+#define STREM_CACHE_H_
+#include "strem_common.h"
+#include "strem_ht.h"
+
+typedef enum {
+	// Hit moves entry to the front of recency list, the back one is evicted
+	STREM_CACHE_LRU = 0,
+	// Hit only marks entry referenced, so hits write no pointers.
+	// Hand walks entries in insertion order clearing marks, the first unmarked one is evicted.
+	STREM_CACHE_CLOCK,
+} StremCacheMode;
+
+// Recency links are stored right before key and value inside the table's value slot,
+// which never moves, so an entry takes no allocation of its own
+typedef struct StremCacheNode {
+	struct StremCacheNode* prev;
+	struct StremCacheNode* next;
+	size_t referenced; /* STREM_CACHE_CLOCK only, as wide as links to keep content aligned */
+	char content[]; /* TKey padded to pointer, TValue */
+} StremCacheNode;
+
+// Cache of at most capacity entries. Table is sized for them upfront and never grows,
+// so memory stays fixed. Robin hood table is used, so removals leave no dead slots behind.
+typedef struct {
+	/* private: */
+	StremHashTable table; /* TKey -> StremCacheNode */
+	StremCacheNode* head; /* LRU: the most recent entry, CLOCK: the hand; NULL if empty */
+	size_t capacity;
+	size_t key_size;
+	size_t value_size;
+	int mode;
+	/* public: */
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+} StremCache;
+
+// If fails to allocate, cache.table.keys.content == NULL
+// Must: capacity > 0
+StremCache StremCache_construct(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	size_t capacity,
+	StremCacheMode mode
+);
+// Same, table is allocated from allocator (NULL for malloc)
+StremCache StremCache_construct_with(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	size_t capacity,
+	StremCacheMode mode,
+	StremAllocator const* allocator
+);
+
+void StremCache_free(StremCache* cache);
+
+// Returns pointer to cached value (NULL on miss), counting hit or miss
+// Value pointer is valid until the entry is evicted or removed.
+void* StremCache_get(StremCache* cache, void const* key);
+
+// Caches copy of value, overwriting the cached one, evicting an entry if cache is full.
+// Returns pointer to value inside cache, NULL if fails to allocate.
+void* StremCache_put(StremCache* cache, void const* key, void const* value);
+
+// Returns false if there's no such key
+bool StremCache_remove(StremCache* cache, void const* key);
+
+#endif // STREM_CACHE_H_
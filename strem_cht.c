@@ -0,0 +1,412 @@
+#include "strem_cht.h"
+#include "strem_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <assert.h>
+
+#define ALIGNUP(size) (((size) + sizeof(size_t) - 1) / sizeof(size_t) * sizeof(size_t))
+#define KEYSIZE(cht) (sizeof(StremCHTKey) + ALIGNUP((cht).value_offset + (cht).value_size))
+
+#define DEFAULT_CHT_CAP 32
+#define DEFAULT_CHT_SATURATION 0.6f
+// slots moved by one claim during resize
+#define MIGRATE_CHUNK 256
+
+static StremCHTKey* get_key(StremConcurrentHashTable* cht, StremCHTSlots* slots, size_t index) {
+	return (StremCHTKey*)(slots->keys + KEYSIZE(*cht) * index);
+}
+
+static size_t home_index(StremCHTSlots* slots, size_t hash) {
+	return StremIndex_home(hash, slots->cap, STREM_INDEX_MASK);
+}
+
+static size_t next_index(StremCHTSlots* slots, size_t index) {
+	return (index + 1) & (slots->cap - 1);
+}
+
+static pthread_mutex_t* stripe_lock(StremConcurrentHashTable* cht, size_t hash) {
+	return &cht->stripes[StremIndex_mix(hash) >> 58 & (STREM_CHT_STRIPES - 1)].lock;
+}
+
+// Built-in hash of key_size bytes if there's no func for them
+static size_t hash_key(StremConcurrentHashTable* cht, void const* key) {
+	return cht->func != NULL ? cht->func(key) : StremHash_bytes(key, cht->key_size);
+}
+
+static bool cmp_keys(StremConcurrentHashTable* cht, void const* a, void const* b) {
+	return cht->cmp_func != NULL ? cht->cmp_func(a, b) : memcmp(a, b, cht->key_size) == 0;
+}
+
+static void* key_value(StremConcurrentHashTable* cht, StremCHTKey* key) {
+	return key->content + cht->value_offset;
+}
+
+// If fails to allocate, returns NULL
+static StremCHTSlots* slots_construct(StremConcurrentHashTable* cht, size_t cap) {
+	StremCHTSlots* const slots = malloc(sizeof(StremCHTSlots));
+	if(slots == NULL) {
+		return NULL;
+	}
+	// zeroed slots are empty with even seq
+	if((slots->keys = calloc(cap, KEYSIZE(*cht))) == NULL) {
+		free(slots);
+		return NULL;
+	}
+	slots->cap = cap;
+	slots->retired = NULL;
+	atomic_init(&slots->used, 0);
+	return slots;
+}
+
+bool StremConcurrentHashTable_construct(
+	StremConcurrentHashTable* cht,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+) {
+	assert(StremIndex_is_pow2(DEFAULT_CHT_CAP));
+	cht->func = func != NULL ? func : StremHash_for_size(key_size);
+	cht->cmp_func = cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size);
+	cht->key_size = key_size;
+	cht->value_size = value_size;
+	cht->value_offset = ALIGNUP(key_size);
+	cht->saturation = DEFAULT_CHT_SATURATION;
+	atomic_init(&cht->size, 0);
+	atomic_init(&cht->resizing, 0);
+	atomic_init(&cht->migrate_to, NULL);
+	atomic_init(&cht->next_chunk, 0);
+	atomic_init(&cht->done_chunks, 0);
+	atomic_init(&cht->helpers, 0);
+
+	StremCHTSlots* const slots = slots_construct(cht, DEFAULT_CHT_CAP);
+	if(slots == NULL) {
+		return false;
+	}
+	atomic_init(&cht->slots, slots);
+
+	for(size_t i = 0; i < STREM_CHT_STRIPES; i++) {
+		pthread_mutex_init(&cht->stripes[i].lock, NULL);
+	}
+	return true;
+}
+
+void StremConcurrentHashTable_free(StremConcurrentHashTable* cht) {
+	StremCHTSlots* slots = atomic_load(&cht->slots);
+	while(slots != NULL) {
+		StremCHTSlots* const retired = slots->retired;
+		free(slots->keys);
+		free(slots);
+		slots = retired;
+	}
+	atomic_store(&cht->slots, NULL);
+	for(size_t i = 0; i < STREM_CHT_STRIPES; i++) {
+		pthread_mutex_destroy(&cht->stripes[i].lock);
+	}
+}
+
+// Writers bracket every change of a taken slot by these two
+static void write_begin(StremCHTKey* key) {
+	atomic_fetch_add_explicit(&key->seq, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(StremCHTKey* key) {
+	atomic_fetch_add_explicit(&key->seq, 1, memory_order_release);
+}
+
+// Lock-free lookup. Copies value to value_out if it's not NULL.
+static bool read_at(
+	StremConcurrentHashTable* cht, StremCHTSlots* slots, void const* key, size_t hash, void* value_out
+) {
+	size_t index = home_index(slots, hash);
+
+	for(size_t probe = 0; probe < slots->cap; probe++) {
+		StremCHTKey* const cht_key = get_key(cht, slots, index);
+
+		while(true) {
+			const size_t seq = atomic_load_explicit(&cht_key->seq, memory_order_acquire);
+			if(seq & 1) {
+				continue;
+			}
+
+			const int type = atomic_load_explicit(&cht_key->type, memory_order_acquire);
+			if(type == STREM_CHT_EMPTY) {
+				return false;
+			}
+			const bool found = type == STREM_CHT_TAKEN
+				&& cht_key->hash == hash
+				&& cmp_keys(cht, cht_key->content, key);
+			if(found && value_out != NULL) {
+				memcpy(value_out, key_value(cht, cht_key), cht->value_size);
+			}
+
+			atomic_thread_fence(memory_order_acquire);
+			if(atomic_load_explicit(&cht_key->seq, memory_order_relaxed) != seq) {
+				continue;
+			}
+			if(found) {
+				return true;
+			}
+			break;
+		}
+		index = next_index(slots, index);
+	}
+	return false;
+}
+
+bool StremConcurrentHashTable_at(StremConcurrentHashTable* cht, void const* key, void* value_out) {
+	const size_t hash = hash_key(cht, key);
+	return read_at(cht, atomic_load_explicit(&cht->slots, memory_order_acquire), key, hash, value_out);
+}
+
+size_t StremConcurrentHashTable_size(StremConcurrentHashTable* cht) {
+	return atomic_load_explicit(&cht->size, memory_order_relaxed);
+}
+
+// Must: stripe of key is locked, so it's changed by nobody else.
+// Slots of other stripes on the way may be rewritten meanwhile, so they're validated
+// by seq like read_at does.
+// Returns taken slot with key, NULL if there's none.
+// *free_index is set to the first dead or empty slot, cap if there's none.
+static StremCHTKey* locked_find(
+	StremConcurrentHashTable* cht,
+	StremCHTSlots* slots,
+	void const* key,
+	size_t hash,
+	size_t* free_index
+) {
+	size_t index = home_index(slots, hash);
+	*free_index = slots->cap;
+
+	for(size_t probe = 0; probe < slots->cap; probe++) {
+		StremCHTKey* const cht_key = get_key(cht, slots, index);
+		int type;
+		bool found;
+
+		while(true) {
+			const size_t seq = atomic_load_explicit(&cht_key->seq, memory_order_acquire);
+			if(seq & 1) {
+				continue;
+			}
+			type = atomic_load_explicit(&cht_key->type, memory_order_acquire);
+			found = type == STREM_CHT_TAKEN
+				&& cht_key->hash == hash
+				&& cmp_keys(cht, cht_key->content, key);
+
+			atomic_thread_fence(memory_order_acquire);
+			if(atomic_load_explicit(&cht_key->seq, memory_order_relaxed) == seq) {
+				break;
+			}
+		}
+
+		if(found) {
+			return cht_key;
+		}
+		if(type != STREM_CHT_TAKEN && type != STREM_CHT_BUSY && *free_index == slots->cap) {
+			*free_index = index;
+		}
+		if(type == STREM_CHT_EMPTY) {
+			break;
+		}
+		index = next_index(slots, index);
+	}
+	return NULL;
+}
+
+// Claims the first empty or dead slot from index on, racing with writers of other stripes.
+// Returns NULL if every slot is taken.
+static StremCHTKey* claim_slot(StremConcurrentHashTable* cht, StremCHTSlots* slots, size_t index) {
+	for(size_t probe = 0; probe < slots->cap; probe++) {
+		StremCHTKey* const cht_key = get_key(cht, slots, index);
+		/* acquire pairs with release of the slot's previous writer, whose stores come first */
+		int type = atomic_load_explicit(&cht_key->type, memory_order_acquire);
+
+		while(type == STREM_CHT_EMPTY || type == STREM_CHT_DEAD) {
+			if(atomic_compare_exchange_weak_explicit(
+				&cht_key->type, &type, STREM_CHT_BUSY, memory_order_acq_rel, memory_order_acquire
+			)) {
+				if(type == STREM_CHT_EMPTY) {
+					atomic_fetch_add_explicit(&slots->used, 1, memory_order_relaxed);
+				}
+				return cht_key;
+			}
+		}
+		index = next_index(slots, index);
+	}
+	return NULL;
+}
+
+// Copies old taken slots of the chunk into new array
+static void migrate_chunk(
+	StremConcurrentHashTable* cht, StremCHTSlots* from, StremCHTSlots* to, size_t chunk
+) {
+	const size_t end = (chunk + 1) * MIGRATE_CHUNK < from->cap ? (chunk + 1) * MIGRATE_CHUNK : from->cap;
+
+	for(size_t i = chunk * MIGRATE_CHUNK; i < end; i++) {
+		StremCHTKey* const old_key = get_key(cht, from, i);
+		if(atomic_load_explicit(&old_key->type, memory_order_acquire) != STREM_CHT_TAKEN) {
+			continue;
+		}
+		StremCHTKey* const new_key = claim_slot(cht, to, home_index(to, old_key->hash));
+		assert(new_key != NULL && "New array is never smaller, so it fits every taken slot");
+		new_key->hash = old_key->hash;
+		memcpy(new_key->content, old_key->content, KEYSIZE(*cht) - sizeof(StremCHTKey));
+		atomic_store_explicit(&new_key->type, STREM_CHT_TAKEN, memory_order_release);
+	}
+}
+
+// Moves chunks of resize in progress until none is left. Must: holds no stripe.
+static void help_migrate(StremConcurrentHashTable* cht) {
+	if(atomic_load(&cht->migrate_to) == NULL) {
+		return;
+	}
+
+	// registered helper keeps the resize from finishing and starting the next one
+	atomic_fetch_add(&cht->helpers, 1);
+	StremCHTSlots* const to = atomic_load(&cht->migrate_to);
+	if(to != NULL) {
+		StremCHTSlots* const from = atomic_load(&cht->slots);
+		const size_t chunks = (from->cap + MIGRATE_CHUNK - 1) / MIGRATE_CHUNK;
+
+		for(size_t chunk = atomic_fetch_add(&cht->next_chunk, 1); chunk < chunks;
+			chunk = atomic_fetch_add(&cht->next_chunk, 1)
+		) {
+			migrate_chunk(cht, from, to, chunk);
+			atomic_fetch_add_explicit(&cht->done_chunks, 1, memory_order_release);
+		}
+	}
+	atomic_fetch_sub(&cht->helpers, 1);
+}
+
+static bool over_saturation(StremConcurrentHashTable* cht, StremCHTSlots* slots) {
+	return (float)atomic_load_explicit(&slots->used, memory_order_relaxed) / slots->cap
+		>= cht->saturation;
+}
+
+// Grows the table if it's saturated, or rehashes it in the same capacity
+// if it's saturated mostly by dead slots. Returns false if fails to allocate.
+static bool resize(StremConcurrentHashTable* cht) {
+	int expected = 0;
+	if(!atomic_compare_exchange_strong(&cht->resizing, &expected, 1)) {
+		help_migrate(cht);
+		sched_yield();
+		return true;
+	}
+
+	for(size_t i = 0; i < STREM_CHT_STRIPES; i++) {
+		pthread_mutex_lock(&cht->stripes[i].lock);
+	}
+
+	bool ok = true;
+	StremCHTSlots* const from = atomic_load(&cht->slots);
+	if(over_saturation(cht, from)) {
+		const size_t size = atomic_load(&cht->size);
+		const size_t newcap = (float)size * 2 / from->cap >= cht->saturation ? from->cap * 2 : from->cap;
+		StremCHTSlots* const to = slots_construct(cht, newcap);
+
+		if(to != NULL) {
+			const size_t chunks = (from->cap + MIGRATE_CHUNK - 1) / MIGRATE_CHUNK;
+			atomic_store(&cht->next_chunk, 0);
+			atomic_store(&cht->done_chunks, 0);
+			atomic_store(&cht->migrate_to, to);
+
+			help_migrate(cht);
+			while(atomic_load_explicit(&cht->done_chunks, memory_order_acquire) < chunks) {
+				sched_yield();
+			}
+
+			// late helpers still read old slots, so they're replaced after all leave
+			atomic_store(&cht->migrate_to, NULL);
+			while(atomic_load(&cht->helpers) != 0) {
+				sched_yield();
+			}
+			to->retired = from;
+			atomic_store_explicit(&cht->slots, to, memory_order_release);
+		} else {
+			ok = false;
+		}
+	}
+
+	for(size_t i = STREM_CHT_STRIPES; i > 0; i--) {
+		pthread_mutex_unlock(&cht->stripes[i - 1].lock);
+	}
+	atomic_store(&cht->resizing, 0);
+	return ok;
+}
+
+bool StremConcurrentHashTable_insert(
+	StremConcurrentHashTable* cht, void const* key, void const* value, bool* inserted
+) {
+	const size_t hash = hash_key(cht, key);
+	pthread_mutex_t* const lock = stripe_lock(cht, hash);
+
+	while(true) {
+		help_migrate(cht);
+		pthread_mutex_lock(lock);
+		StremCHTSlots* const slots = atomic_load_explicit(&cht->slots, memory_order_acquire);
+
+		size_t free_index;
+		StremCHTKey* cht_key = locked_find(cht, slots, key, hash, &free_index);
+		if(cht_key != NULL) {
+			write_begin(cht_key);
+			memcpy(key_value(cht, cht_key), value, cht->value_size);
+			write_end(cht_key);
+			pthread_mutex_unlock(lock);
+			*inserted = false;
+			return true;
+		}
+
+		if(free_index != slots->cap && (cht_key = claim_slot(cht, slots, free_index)) != NULL) {
+			write_begin(cht_key);
+			cht_key->hash = hash;
+			memcpy(cht_key->content, key, cht->key_size);
+			memcpy(key_value(cht, cht_key), value, cht->value_size);
+			atomic_store_explicit(&cht_key->type, STREM_CHT_TAKEN, memory_order_release);
+			write_end(cht_key);
+			atomic_fetch_add_explicit(&cht->size, 1, memory_order_relaxed);
+			pthread_mutex_unlock(lock);
+
+			*inserted = true;
+			if(over_saturation(cht, slots)) {
+				resize(cht);
+			}
+			return true;
+		}
+
+		// no free slot, grow and retry
+		pthread_mutex_unlock(lock);
+		if(!resize(cht)) {
+			return false;
+		}
+	}
+}
+
+bool StremConcurrentHashTable_remove(
+	StremConcurrentHashTable* cht, void const* key, void* value_out
+) {
+	const size_t hash = hash_key(cht, key);
+	pthread_mutex_t* const lock = stripe_lock(cht, hash);
+
+	help_migrate(cht);
+	pthread_mutex_lock(lock);
+	StremCHTSlots* const slots = atomic_load_explicit(&cht->slots, memory_order_acquire);
+
+	size_t free_index;
+	StremCHTKey* const cht_key = locked_find(cht, slots, key, hash, &free_index);
+	if(cht_key == NULL) {
+		pthread_mutex_unlock(lock);
+		return false;
+	}
+
+	if(value_out != NULL) {
+		memcpy(value_out, key_value(cht, cht_key), cht->value_size);
+	}
+	write_begin(cht_key);
+	atomic_store_explicit(&cht_key->type, STREM_CHT_DEAD, memory_order_release);
+	write_end(cht_key);
+	atomic_fetch_sub_explicit(&cht->size, 1, memory_order_relaxed);
+	pthread_mutex_unlock(lock);
+	return true;
+}
@@ -0,0 +1,91 @@
+#ifndef STREM_CHT_H_
+#define STREM_CHT_H_
+#include <stdatomic.h>
+#include <pthread.h>
+#include "strem_common.h"
+#include "strem_ht.h"
+
+// Stripes of writer locks, key's stripe is chosen by its hash
+#define STREM_CHT_STRIPES 64
+
+typedef struct {
+	atomic_size_t seq; /* odd while slot is being written */
+	atomic_int type;
+	size_t hash;
+	char content[]; /* key, then value */
+} StremCHTKey;
+
+enum {
+	STREM_CHT_EMPTY = 0,
+	STREM_CHT_BUSY, /* claimed by insert, not written yet */
+	STREM_CHT_TAKEN,
+	STREM_CHT_DEAD,
+};
+
+typedef struct StremCHTSlots {
+	char* /* StremCHTKey + TKey + TValue */ keys;
+	size_t cap; /* power of two */
+	atomic_size_t used; /* taken, busy and dead slots */
+	struct StremCHTSlots* retired; /* previous arrays, freed with the table */
+} StremCHTSlots;
+
+typedef struct {
+	pthread_mutex_t lock;
+	char pad[64 - sizeof(pthread_mutex_t) % 64];
+} StremCHTStripe;
+
+// Concurrent open-addressing table with values stored inside slots.
+// Readers take no locks: slots are validated by their seq and reread if it changed.
+// Writers lock the stripe of the key and claim slots by CAS on their type.
+// Removed slots become dead and are reused by inserts.
+// Resize takes all stripes, writers coming meanwhile help moving slots chunk by chunk.
+// Replaced arrays are kept until StremConcurrentHashTable_free, so readers never
+// touch freed memory; together they take less memory than the current one.
+typedef struct {
+	/* private: */
+	_Atomic(StremCHTSlots*) slots;
+	StremCHTStripe stripes[STREM_CHT_STRIPES];
+	atomic_size_t size;
+	atomic_int resizing;
+	/* resize in progress, migrate_to == NULL otherwise: */
+	_Atomic(StremCHTSlots*) migrate_to;
+	atomic_size_t next_chunk;
+	atomic_size_t done_chunks;
+	atomic_int helpers;
+	StremHashFunction func;
+	StremCmpFunction cmp_func;
+	size_t key_size;
+	size_t value_size;
+	size_t value_offset; /* of value inside content */
+	/* public: */
+	float saturation;
+} StremConcurrentHashTable;
+
+// Constructs table in place, since it holds mutexes.
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h)
+// Returns false if fails to allocate.
+bool StremConcurrentHashTable_construct(
+	StremConcurrentHashTable* cht,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+);
+// Must: no other thread uses the table
+void StremConcurrentHashTable_free(StremConcurrentHashTable* cht);
+
+// Inserts pair or overwrites value of existing key, *inserted tells which one happened.
+// Returns false if there's no free slot and fails to grow the table.
+bool StremConcurrentHashTable_insert(
+	StremConcurrentHashTable* cht, void const* key, void const* value, bool* inserted
+);
+// Copies associated value to value_out. Returns false if no key found. Lock-free.
+bool StremConcurrentHashTable_at(StremConcurrentHashTable* cht, void const* key, void* value_out);
+// Removes the pair, copying its value to value_out unless it's NULL.
+// Returns false if no key found.
+bool StremConcurrentHashTable_remove(
+	StremConcurrentHashTable* cht, void const* key, void* value_out
+);
+size_t StremConcurrentHashTable_size(StremConcurrentHashTable* cht);
+
+#endif // STREM_CHT_H_
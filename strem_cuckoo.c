@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "strem_cuckoo.h"
+#include "strem_index.h"
+#include "strem_hash.h"
+
+#define BUCKETSIZE(cs) ((sizeof(StremCuckooBucket) + (cs).key_size * STREM_CUCKOO_SLOTS \
+	+ STREM_CUCKOO_LINE - 1) / STREM_CUCKOO_LINE * STREM_CUCKOO_LINE)
+#define FULL_MASK (((size_t)1 << STREM_CUCKOO_SLOTS) - 1)
+
+#define DEFAULT_CUCKOO_BUCKETS 8
+// buckets visited by breadth-first search of a path to free slot
+#define SEARCH_MAX 256
+// doublings of bucket count done by one insert or resize, in total; keys sharing a hash
+// beyond two buckets never fit, so growth must stop somewhere
+#define GROW_MAX 4
+
+// Bucket visited by path search, its keys may move to the buckets visited after it
+typedef struct {
+	size_t bucket;
+	int parent; /* node, one of whose keys moves here, -1 for the key's own buckets */
+	int slot; /* slot of that key in parent bucket */
+} SearchNode;
+
+static StremCuckooBucket* get_bucket(StremCuckooSet* cs, size_t index) {
+	return (StremCuckooBucket*)((char*)cs->buckets + BUCKETSIZE(*cs) * index);
+}
+
+static char* slot_key(StremCuckooSet* cs, StremCuckooBucket* bucket, size_t slot) {
+	return bucket->content + cs->key_size * slot;
+}
+
+// Built-in hash of key_size bytes if there's no func for them
+static size_t hash_key(StremCuckooSet* cs, void const* key) {
+	return cs->func != NULL ? cs->func(key) : StremHash_bytes(key, cs->key_size);
+}
+
+static bool cmp_keys(StremCuckooSet* cs, void const* a, void const* b) {
+	return cs->cmp_func != NULL ? cs->cmp_func(a, b) : memcmp(a, b, cs->key_size) == 0;
+}
+
+// Top bits of mixed hash, its low bits pick the first bucket
+static uint16_t fingerprint(size_t mixed) {
+	return (uint16_t)(mixed >> (sizeof(size_t) * 8 - 16));
+}
+
+// Partial-key cuckoo: the other bucket is bucket xor an odd offset of fingerprint,
+// so it's found from either one without the key. The same bucket only if there's one.
+static size_t other_bucket(uint16_t fingerprint, size_t bucket, size_t bucket_count) {
+	return (bucket ^ (StremIndex_mix(fingerprint) | 1)) & (bucket_count - 1);
+}
+
+static void bucket_pair(size_t mixed, size_t bucket_count, size_t pair[2]) {
+	pair[0] = mixed & (bucket_count - 1);
+	pair[1] = other_bucket(fingerprint(mixed), pair[0], bucket_count);
+}
+
+static StremCuckooBucket* find(StremCuckooSet* cs, void const* key, size_t mixed, size_t* slot_out) {
+	const uint16_t fp = fingerprint(mixed);
+	size_t pair[2];
+	bucket_pair(mixed, cs->bucket_count, pair);
+
+	for(size_t i = 0; i < 2; i++) {
+		StremCuckooBucket* const bucket = get_bucket(cs, pair[i]);
+
+		for(size_t taken = bucket->taken; taken != 0; taken &= taken - 1) {
+			const size_t slot = (size_t)__builtin_ctzll(taken);
+			if(bucket->fingerprints[slot] == fp && cmp_keys(cs, slot_key(cs, bucket, slot), key)) {
+				*slot_out = slot;
+				return bucket;
+			}
+		}
+	}
+	return NULL;
+}
+
+// Keys of equal hash share both buckets at any bucket count, so growing can't make room
+// for one more if they fill them. Slots keep just fingerprints, so keys are rehashed.
+static bool hash_fills_pair(StremCuckooSet* cs, size_t hash) {
+	size_t pair[2];
+	bucket_pair(StremIndex_mix(hash), cs->bucket_count, pair);
+
+	for(size_t i = 0; i < (pair[1] != pair[0] ? 2 : 1); i++) {
+		StremCuckooBucket* const bucket = get_bucket(cs, pair[i]);
+		for(size_t slot = 0; slot < STREM_CUCKOO_SLOTS; slot++) {
+			if(!(bucket->taken >> slot & 1) || hash_key(cs, slot_key(cs, bucket, slot)) != hash) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Cache line aligned unless allocator is custom
+static void* alloc_buckets(StremAllocator const* allocator, size_t count, size_t bucket_size) {
+	if(allocator != NULL) {
+		return StremAllocator_calloc(allocator, count, bucket_size);
+	}
+	if(count > STREM_SIZE_MAX / bucket_size) {
+		return NULL;
+	}
+	void* const buckets = aligned_alloc(STREM_CUCKOO_LINE, count * bucket_size);
+	if(buckets != NULL) {
+		memset(buckets, 0, count * bucket_size);
+	}
+	return buckets;
+}
+
+static bool on_path(SearchNode const* nodes, int node, size_t bucket) {
+	for(; node >= 0; node = nodes[node].parent) {
+		if(nodes[node].bucket == bucket) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Moves every key on path ending at nodes[last] one bucket further,
+// then puts key to the slot freed in the first bucket
+static char* shift_path(
+	StremCuckooSet* cs, SearchNode const* nodes, int last, size_t free_slot, void const* key, uint16_t fp
+) {
+	SearchNode node = nodes[last];
+	size_t to_slot = free_slot;
+
+	while(node.parent >= 0) {
+		const SearchNode parent = nodes[node.parent];
+		StremCuckooBucket* const from = get_bucket(cs, parent.bucket);
+		StremCuckooBucket* const to = get_bucket(cs, node.bucket);
+
+		memcpy(slot_key(cs, to, to_slot), slot_key(cs, from, (size_t)node.slot), cs->key_size);
+		to->fingerprints[to_slot] = from->fingerprints[node.slot];
+		to->taken |= (uint8_t)(1u << to_slot);
+
+		to_slot = (size_t)node.slot;
+		node = parent;
+	}
+
+	StremCuckooBucket* const bucket = get_bucket(cs, node.bucket);
+	memcpy(slot_key(cs, bucket, to_slot), key, cs->key_size);
+	bucket->fingerprints[to_slot] = fp;
+	bucket->taken |= (uint8_t)(1u << to_slot);
+	return slot_key(cs, bucket, to_slot);
+}
+
+// Finds the shortest path to free slot breadth-first and shifts keys along it.
+// Returns NULL and moves nothing if no path is found.
+static char* place(StremCuckooSet* cs, void const* key, size_t mixed) {
+	SearchNode nodes[SEARCH_MAX];
+	size_t pair[2];
+	int count = 0;
+
+	bucket_pair(mixed, cs->bucket_count, pair);
+	nodes[count++] = (SearchNode){ pair[0], -1, 0 };
+	if(pair[1] != pair[0]) {
+		nodes[count++] = (SearchNode){ pair[1], -1, 0 };
+	}
+
+	for(int i = 0; i < count; i++) {
+		StremCuckooBucket* const bucket = get_bucket(cs, nodes[i].bucket);
+		const size_t free = ~bucket->taken & FULL_MASK;
+		if(free != 0) {
+			return shift_path(cs, nodes, i, (size_t)__builtin_ctzll(free), key, fingerprint(mixed));
+		}
+
+		for(int slot = 0; slot < STREM_CUCKOO_SLOTS && count < SEARCH_MAX; slot++) {
+			const size_t other = other_bucket(bucket->fingerprints[slot], nodes[i].bucket, cs->bucket_count);
+			/* bucket met twice would lose one of keys moved to it */
+			if(!on_path(nodes, i, other)) {
+				nodes[count++] = (SearchNode){ other, i, slot };
+			}
+		}
+	}
+	return NULL;
+}
+
+StremCuckooSet StremCuckooSet_construct(
+	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func
+) {
+	return StremCuckooSet_construct_with(key_size, func, cmp_func, NULL);
+}
+
+StremCuckooSet StremCuckooSet_construct_with(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremAllocator const* allocator
+) {
+	assert(StremIndex_is_pow2(DEFAULT_CUCKOO_BUCKETS));
+	StremCuckooSet cs = {
+		NULL,
+		func != NULL ? func : StremHash_for_size(key_size),
+		cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size),
+		DEFAULT_CUCKOO_BUCKETS,
+		0,
+		key_size,
+		false,
+		allocator
+	};
+
+	cs.buckets = alloc_buckets(allocator, DEFAULT_CUCKOO_BUCKETS, BUCKETSIZE(cs));
+	return cs;
+}
+
+StremCuckooSet StremCuckooSet_emplace(
+	void* at_buf,
+	size_t at_buf_size,
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+) {
+	const size_t skip = (size_t)(-(uintptr_t)at_buf & (STREM_CUCKOO_LINE - 1));
+	StremCuckooSet cs = {
+		(char*)at_buf + skip,
+		func != NULL ? func : StremHash_for_size(key_size),
+		cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size),
+		1,
+		0,
+		key_size,
+		true,
+		NULL
+	};
+	assert(at_buf_size >= skip + BUCKETSIZE(cs) && "Buffer must fit at least one bucket");
+	const size_t fit = (at_buf_size - skip) / BUCKETSIZE(cs);
+
+	while(cs.bucket_count * 2 <= fit) {
+		cs.bucket_count *= 2;
+	}
+	memset(cs.buckets, 0, cs.bucket_count * BUCKETSIZE(cs));
+	return cs;
+}
+
+void StremCuckooSet_free(StremCuckooSet* cs) {
+	if(!cs->emplaced) {
+		StremAllocator_free(cs->allocator, cs->buckets);
+	}
+	cs->buckets = NULL;
+	cs->size = 0;
+}
+
+// Rehashes into bucket_count buckets, doubling them until keys fit, up to max_count
+static bool resize_upto(StremCuckooSet* cs, size_t bucket_count, size_t max_count) {
+	if(cs->emplaced) {
+		return false;
+	}
+
+	StremCuckooSet newcs = *cs;
+	for(;; bucket_count *= 2) {
+		newcs.bucket_count = bucket_count;
+		if((newcs.buckets = alloc_buckets(cs->allocator, bucket_count, BUCKETSIZE(newcs))) == NULL) {
+			return false;
+		}
+
+		bool placed_all = true;
+		for(size_t i = 0; i < cs->bucket_count && placed_all; i++) {
+			StremCuckooBucket* const bucket = get_bucket(cs, i);
+
+			for(size_t taken = bucket->taken; taken != 0; taken &= taken - 1) {
+				char const* const key = slot_key(cs, bucket, (size_t)__builtin_ctzll(taken));
+				if(place(&newcs, key, StremIndex_mix(hash_key(cs, key))) == NULL) {
+					placed_all = false;
+					break;
+				}
+			}
+		}
+		if(placed_all) {
+			break;
+		}
+
+		StremAllocator_free(cs->allocator, newcs.buckets);
+		if(bucket_count >= max_count) {
+			return false;
+		}
+	}
+
+	StremAllocator_free(cs->allocator, cs->buckets);
+	*cs = newcs;
+	return true;
+}
+
+bool StremCuckooSet_resize(StremCuckooSet* cs, size_t bucket_count) {
+	assert(StremIndex_is_pow2(bucket_count));
+	return resize_upto(cs, bucket_count, bucket_count << GROW_MAX);
+}
+
+void* StremCuckooSet_insert(StremCuckooSet* cs, void const* key) {
+	const size_t hash = hash_key(cs, key);
+	const size_t mixed = StremIndex_mix(hash);
+	const size_t max_count = cs->bucket_count << GROW_MAX;
+	size_t slot;
+	StremCuckooBucket* const bucket = find(cs, key, mixed, &slot);
+	if(bucket != NULL) {
+		return slot_key(cs, bucket, slot);
+	}
+
+	while(true) {
+		char* const placed = place(cs, key, mixed);
+		if(placed != NULL) {
+			cs->size++;
+			return placed;
+		}
+		if(cs->bucket_count >= max_count || hash_fills_pair(cs, hash)
+			|| !resize_upto(cs, cs->bucket_count * 2, max_count)
+		) {
+			return NULL;
+		}
+	}
+}
+
+void* StremCuckooSet_remove(StremCuckooSet* cs, void const* key) {
+	size_t slot;
+	StremCuckooBucket* const bucket = find(cs, key, StremIndex_mix(hash_key(cs, key)), &slot);
+	if(bucket == NULL) {
+		return NULL;
+	}
+
+	bucket->taken &= (uint8_t)~(1u << slot);
+	cs->size--;
+	return slot_key(cs, bucket, slot);
+}
+
+void* StremCuckooSet_at(StremCuckooSet* cs, void const* key) {
+	size_t slot;
+	StremCuckooBucket* const bucket = find(cs, key, StremIndex_mix(hash_key(cs, key)), &slot);
+	return bucket != NULL ? slot_key(cs, bucket, slot) : NULL;
+}
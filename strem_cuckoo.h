@@ -0,0 +1,90 @@
+#ifndef STREM_CUCKOO_H_
+#define STREM_CUCKOO_H_
+#include <stdint.h>
+#include "strem_common.h"
+#include "strem_hs.h"
+
+// Slots per bucket, 4 to 8
+#ifndef STREM_CUCKOO_SLOTS
+#define STREM_CUCKOO_SLOTS 4
+#endif
+_Static_assert(STREM_CUCKOO_SLOTS >= 1 && STREM_CUCKOO_SLOTS <= 8,
+	"Bucket's taken bitmap and path search assume 1 to 8 slots");
+// Buckets are aligned and padded to it
+#define STREM_CUCKOO_LINE 64
+
+typedef struct {
+	uint16_t fingerprints[STREM_CUCKOO_SLOTS]; /* of hashes of keys, see strem_cuckoo.c */
+	uint8_t taken; /* bit i is set if slot i holds a key */
+	_Alignas(size_t) char content[]; /* STREM_CUCKOO_SLOTS keys */
+} StremCuckooBucket;
+
+// Bucket of keys up to it fits one line, so lookup touches at most two lines
+#define STREM_CUCKOO_LINE_KEY_SIZE ((STREM_CUCKOO_LINE - sizeof(StremCuckooBucket)) / STREM_CUCKOO_SLOTS)
+_Static_assert(STREM_CUCKOO_LINE_KEY_SIZE >= (STREM_CUCKOO_SLOTS <= 4 ? sizeof(uint64_t) : sizeof(uint32_t)),
+	"Bucket of 8-byte keys (4-byte ones above 4 slots) must fit one line");
+
+// Bucketized cuckoo set: every key is in one of its two buckets,
+// so lookup and remove probe at most two buckets whatever the load.
+// Slots keep 16-bit fingerprints instead of hashes, the other bucket of a key is
+// derived from its fingerprint, so keys move without rehashing; resize rehashes them.
+// Insert moves keys to their other buckets along the shortest path found
+// to a free slot; if there's none, malloced set grows, emplaced one fails.
+// One insert grows set at most 16 times, so keys sharing a hash beyond two buckets
+// fail instead of growing it forever.
+typedef struct {
+	/* private: */
+	void* /* StremCuckooBucket + TKey[STREM_CUCKOO_SLOTS] */ buckets;
+	StremHashFunction func;
+	StremCmpFunction cmp_func;
+	size_t bucket_count; /* power of two */
+	size_t size;
+	size_t key_size;
+	bool emplaced;
+	StremAllocator const* allocator; /* NULL for malloc */
+} StremCuckooSet;
+
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h)
+// If fails to allocate, set.buckets == NULL
+StremCuckooSet StremCuckooSet_construct(
+	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func
+);
+// Same, buckets are allocated from allocator (NULL for malloc)
+StremCuckooSet StremCuckooSet_construct_with(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremAllocator const* allocator
+);
+
+// Set inside at_buf, which is used from its first STREM_CUCKOO_LINE boundary
+// as far as a power of two of buckets fits it. Emplaced set never grows.
+// Must: at_buf fits at least one bucket after that boundary
+StremCuckooSet StremCuckooSet_emplace(
+	void* at_buf,
+	size_t at_buf_size,
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+);
+
+void StremCuckooSet_free(StremCuckooSet* cs);
+
+// Inserts and returns pointer to key inside set, or to equal key already there.
+// Pointer is valid until the next insert.
+// Returns NULL if there's no room and set can't grow; set is unchanged then.
+void* StremCuckooSet_insert(StremCuckooSet* cs, void const* key);
+
+// Removes the key and returns ptr to just removed key (NULL if no key found).
+// key pointer is valid until the next insert.
+void* StremCuckooSet_remove(StremCuckooSet* cs, void const* key);
+
+// Returns pointer to key inside set (NULL if no key found)
+void* StremCuckooSet_at(StremCuckooSet* cs, void const* key);
+
+// Rehashes into bucket_count buckets, more if keys don't fit them (up to 16 times more).
+// Returns false and keeps set if can't allocate, keys don't fit or set is emplaced.
+// Must: bucket_count is a power of two
+bool StremCuckooSet_resize(StremCuckooSet* cs, size_t bucket_count);
+
+#endif // STREM_CUCKOO_H_
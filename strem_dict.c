@@ -0,0 +1,245 @@
+#include <string.h>
+#include <assert.h>
+#include "strem_dict.h"
+#include "strem_index.h"
+
+#define KEYSPAN(d) (((d).key_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*))
+#define ENTRYSIZE(d) ((sizeof(StremDictEntry) + KEYSPAN(d) + (d).value_size + sizeof(size_t) - 1) \
+	/ sizeof(size_t) * sizeof(size_t))
+
+#define DEFAULT_DICT_CAP 8
+// index numbers: entry i is stored as i + INDEX_FIRST
+#define INDEX_EMPTY 0
+#define INDEX_DUMMY 1 /* entry was removed, probing goes on */
+#define INDEX_FIRST 2
+#define DEAD_HASH STREM_SIZE_MAX
+
+// Entries fit 2/3 of index, so probe sequences stay short
+static size_t usable(size_t index_cap) {
+	return index_cap * 2 / 3;
+}
+
+// The narrowest width which numbers all usable entries
+static unsigned int index_width(size_t index_cap) {
+	const size_t max_number = usable(index_cap) + INDEX_FIRST;
+	if(max_number <= UINT8_MAX) {
+		return 1;
+	} else if(max_number <= UINT16_MAX) {
+		return 2;
+	} else if(max_number <= UINT32_MAX) {
+		return 4;
+	}
+	return 8;
+}
+
+static size_t index_get(StremDict* d, size_t slot) {
+	switch(d->index_width) {
+	case 1: return ((uint8_t*)d->index)[slot];
+	case 2: return ((uint16_t*)d->index)[slot];
+	case 4: return ((uint32_t*)d->index)[slot];
+	default: return (size_t)((uint64_t*)d->index)[slot];
+	}
+}
+
+static void index_set(StremDict* d, size_t slot, size_t number) {
+	switch(d->index_width) {
+	case 1: ((uint8_t*)d->index)[slot] = (uint8_t)number; break;
+	case 2: ((uint16_t*)d->index)[slot] = (uint16_t)number; break;
+	case 4: ((uint32_t*)d->index)[slot] = (uint32_t)number; break;
+	default: ((uint64_t*)d->index)[slot] = (uint64_t)number; break;
+	}
+}
+
+static StremDictEntry* get_entry(StremDict* d, size_t i) {
+	return (StremDictEntry*)((char*)d->entries.content + ENTRYSIZE(*d) * i);
+}
+
+static char* value_of(StremDict* d, StremDictEntry* entry) {
+	return entry->content + KEYSPAN(*d);
+}
+
+// DEAD_HASH marks removed entries, so hash function never returns it
+static size_t hash_of(StremDict* d, void const* key) {
+	const size_t hash = d->func(key);
+	return hash != DEAD_HASH ? hash : DEAD_HASH - 1;
+}
+
+static size_t next_slot(StremDict* d, size_t slot, size_t probe) {
+	return StremIndex_next(slot, probe, d->index_cap, STREM_INDEX_MASK, STREM_SEQ_LINEAR, 1);
+}
+
+// Returns index slot of key's entry, or empty slot ending its probe sequence (*entry_out = NULL)
+static size_t lookup(StremDict* d, void const* key, size_t hash, StremDictEntry** entry_out) {
+	size_t slot = StremIndex_home(hash, d->index_cap, STREM_INDEX_MASK);
+
+	for(size_t probe = 1;; probe++) {
+		const size_t number = index_get(d, slot);
+
+		if(number == INDEX_EMPTY) {
+			*entry_out = NULL;
+			return slot;
+		}
+		if(number != INDEX_DUMMY) {
+			StremDictEntry* const entry = get_entry(d, number - INDEX_FIRST);
+			if(entry->hash == hash && d->cmp_func(entry->content, key)) {
+				*entry_out = entry;
+				return slot;
+			}
+		}
+		slot = next_slot(d, slot, probe);
+	}
+}
+
+// Drops removed entries keeping order of the rest, then indexes them in index_cap slots.
+// Returns false and keeps dict if fails to allocate.
+static bool rebuild(StremDict* d, size_t index_cap) {
+	const unsigned int width = index_width(index_cap);
+	void* const index = StremAllocator_calloc(d->allocator, index_cap, width);
+	if(index == NULL) {
+		return false;
+	}
+	if(!StremVector_reserve(&d->entries, usable(index_cap))) {
+		StremAllocator_free(d->allocator, index);
+		return false;
+	}
+
+	StremAllocator_free(d->allocator, d->index);
+	d->index = index;
+	d->index_cap = index_cap;
+	d->index_width = width;
+
+	size_t kept = 0;
+	for(size_t i = 0; i < d->entries.size; i++) {
+		StremDictEntry* const entry = get_entry(d, i);
+		if(entry->hash == DEAD_HASH) {
+			continue;
+		}
+		if(kept != i) {
+			memcpy(get_entry(d, kept), entry, ENTRYSIZE(*d));
+		}
+
+		size_t slot = StremIndex_home(entry->hash, index_cap, STREM_INDEX_MASK);
+		for(size_t probe = 1; index_get(d, slot) != INDEX_EMPTY; probe++) {
+			slot = next_slot(d, slot, probe);
+		}
+		index_set(d, slot, kept + INDEX_FIRST);
+		kept++;
+	}
+	d->entries.size = kept;
+	return true;
+}
+
+StremDict StremDict_construct(
+	size_t key_size, size_t value_size, StremHashFunction func, StremCmpFunction cmp_func
+) {
+	return StremDict_construct_with(key_size, value_size, func, cmp_func, NULL);
+}
+
+StremDict StremDict_construct_with(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremAllocator const* allocator
+) {
+	assert(StremIndex_is_pow2(DEFAULT_DICT_CAP));
+	StremDict d = {
+		NULL,
+		{ 0 },
+		func != NULL ? func : StremHash_for_size(key_size),
+		cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size),
+		DEFAULT_DICT_CAP,
+		0,
+		key_size,
+		value_size,
+		index_width(DEFAULT_DICT_CAP),
+		allocator
+	};
+
+	d.entries = StremVector_construct_with(ENTRYSIZE(d), usable(DEFAULT_DICT_CAP), allocator);
+	if(d.entries.content == NULL) {
+		return d;
+	}
+	if((d.index = StremAllocator_calloc(allocator, DEFAULT_DICT_CAP, d.index_width)) == NULL) {
+		StremVector_free(&d.entries);
+	}
+	return d;
+}
+
+void StremDict_free(StremDict* d) {
+	StremAllocator_free(d->allocator, d->index);
+	StremVector_free(&d->entries);
+	d->index = NULL;
+	d->size = 0;
+}
+
+bool StremDict_reserve(StremDict* d, size_t count) {
+	size_t index_cap = d->index_cap;
+	while(usable(index_cap) < count) {
+		index_cap *= 2;
+	}
+	return index_cap == d->index_cap || rebuild(d, index_cap);
+}
+
+void* StremDict_insert(StremDict* d, void const* key, void const* value) {
+	const size_t hash = hash_of(d, key);
+	StremDictEntry* entry;
+	size_t slot = lookup(d, key, hash, &entry);
+
+	if(entry != NULL) {
+		memcpy(value_of(d, entry), value, d->value_size);
+		return value_of(d, entry);
+	}
+
+	if(d->entries.size == usable(d->index_cap)) {
+		/* compacting is enough if at least half of entries are removed */
+		const size_t index_cap = d->size * 2 < usable(d->index_cap) ? d->index_cap : d->index_cap * 2;
+		if(!rebuild(d, index_cap)) {
+			return NULL;
+		}
+		slot = lookup(d, key, hash, &entry);
+	}
+
+	entry = get_entry(d, d->entries.size);
+	entry->hash = hash;
+	memcpy(entry->content, key, d->key_size);
+	memcpy(value_of(d, entry), value, d->value_size);
+	index_set(d, slot, d->entries.size + INDEX_FIRST);
+	d->entries.size++;
+	d->size++;
+
+	return value_of(d, entry);
+}
+
+void* StremDict_remove(StremDict* d, void const* key) {
+	StremDictEntry* entry;
+	const size_t slot = lookup(d, key, hash_of(d, key), &entry);
+
+	if(entry == NULL) {
+		return NULL;
+	}
+	/* entry stays in place until the next rebuild */
+	index_set(d, slot, INDEX_DUMMY);
+	entry->hash = DEAD_HASH;
+	d->size--;
+	return value_of(d, entry);
+}
+
+void* StremDict_at(StremDict* d, void const* key) {
+	StremDictEntry* entry;
+	lookup(d, key, hash_of(d, key), &entry);
+	return entry != NULL ? value_of(d, entry) : NULL;
+}
+
+bool StremDict_next(StremDict* d, size_t* pos, void** key_out, void** value_out) {
+	for(; *pos < d->entries.size; (*pos)++) {
+		StremDictEntry* const entry = get_entry(d, *pos);
+		if(entry->hash != DEAD_HASH) {
+			*key_out = entry->content;
+			*value_out = value_of(d, entry);
+			(*pos)++;
+			return true;
+		}
+	}
+	return false;
+}
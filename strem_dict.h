@@ -0,0 +1,67 @@
+#ifndef STREM_DICT_H_
+#define STREM_DICT_H_
+#include <stdint.h>
+#include "strem_common.h"
+#include "strem_ht.h"
+
+typedef struct {
+	size_t hash; /* STREM_SIZE_MAX for removed entry */
+	char content[]; /* TKey padded to pointer, TValue */
+} StremDictEntry;
+
+// Compact insertion-ordered table: pairs are appended to a dense entries array,
+// the probed index array holds only numbers of entries, 1 to 8 bytes wide
+// depending on capacity. Iteration walks entries in insertion order.
+// Unlike StremHashTable, values move when the entries grow or are compacted.
+typedef struct {
+	/* private: */
+	void* index; /* index_cap numbers of entries, index_width bytes each */
+	StremVector /* StremDictEntry + TKey + TValue */ entries;
+	StremHashFunction func;
+	StremCmpFunction cmp_func;
+	size_t index_cap; /* power of two */
+	size_t size; /* entries not removed */
+	size_t key_size;
+	size_t value_size;
+	unsigned int index_width;
+	StremAllocator const* allocator; /* NULL for malloc */
+} StremDict;
+
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h)
+// If fails to allocate, dict.index == NULL
+StremDict StremDict_construct(
+	size_t key_size, size_t value_size, StremHashFunction func, StremCmpFunction cmp_func
+);
+// Same, index and entries are allocated from allocator (NULL for malloc)
+StremDict StremDict_construct_with(
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremAllocator const* allocator
+);
+
+void StremDict_free(StremDict* d);
+
+// Appends pair, or overwrites value if there's such key already (its place in order is kept).
+// Returns pointer to value inside dict, valid until the next insert.
+// Returns NULL if fails to allocate.
+void* StremDict_insert(StremDict* d, void const* key, void const* value);
+
+// Removes the pair and returns ptr to its value (NULL if no key found).
+// Value pointer is valid until the next insert.
+void* StremDict_remove(StremDict* d, void const* key);
+
+// Returns pointer to associated value (NULL if no key found)
+void* StremDict_at(StremDict* d, void const* key);
+
+// Walks pairs in insertion order, *pos must be 0 at start:
+// for(size_t pos = 0; StremDict_next(&d, &pos, &key, &value);) {...}
+// Returns false after the last pair. Dict mustn't be changed during the walk.
+bool StremDict_next(StremDict* d, size_t* pos, void** key_out, void** value_out);
+
+// Makes room for count pairs, so inserting them doesn't reallocate.
+// Returns false if fails to allocate.
+bool StremDict_reserve(StremDict* d, size_t count);
+
+#endif // STREM_DICT_H_
@@ -0,0 +1,299 @@
+#ifndef STREM_GEN_H_
+#define STREM_GEN_H_
+#include <stdlib.h>
+#include <string.h>
+#include "strem_group.h"
+
+// Type-specialized hash containers.
+// STREM_HT_DEFINE(name, KeyT, ValT, hash_fn, eq_fn) and STREM_HS_DEFINE(name, KeyT, hash_fn, eq_fn)
+// define struct `name` and static inline functions name_construct, name_free, name_insert,
+// name_at, name_remove, name_resize and name_purge, mirroring StremHashTable and StremHashSet.
+//
+// hash_fn(KeyT) -> size_t and eq_fn(KeyT, KeyT) -> bool may be functions or macros,
+// they are called directly, so the compiler can inline them.
+// Keys and values are stored inside slots and are copied by assignment.
+// Slots are probed by STREM_GROUP_WIDTH control bytes at once,
+// capacity is a power of two indexed by the top bits of Fibonacci-multiplied hash.
+//
+// Unlike StremHashTable, values are moved by resize:
+// pointer to value is valid until the next insert.
+
+#define STREM_GEN_DEFAULT_CAP 32
+#define STREM_GEN_DEFAULT_HT_SATURATION 0.6f
+#define STREM_GEN_DEFAULT_HS_SATURATION 0.5f
+
+// Must: cap is a power of two
+static inline size_t StremGen_shift(size_t cap) {
+	return 64 - (size_t)__builtin_ctzll((unsigned long long)cap);
+}
+
+static inline size_t StremGen_home(size_t hash, size_t shift) {
+	return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ull) >> shift);
+}
+
+static inline uint8_t* StremGen_ctrl_construct(size_t cap) {
+	uint8_t* const ctrl = malloc(cap + STREM_GROUP_WIDTH - 1);
+	if(ctrl != NULL) {
+		memset(ctrl, STREM_CTRL_EMPTY, cap + STREM_GROUP_WIDTH - 1);
+	}
+	return ctrl;
+}
+
+// Common part of both containers. SlotT must have member `key`.
+#define STREM_GEN_PROBING_(name, SlotT, KeyT, hash_fn, eq_fn, default_saturation) \
+\
+static inline SlotT* name##_find_(name* t, KeyT key, size_t hash) { \
+	const uint8_t tag = StremGroup_tag(hash); \
+	const size_t mask = t->cap - 1; \
+	size_t index = StremGen_home(hash, t->shift); \
+\
+	while(true) { \
+		uint8_t const* const group = t->ctrl + index; \
+\
+		for(StremGroupMask match = StremGroup_match(group, tag); match != 0; StremGroupMask_drop(match)) { \
+			SlotT* const slot = &t->slots[(index + StremGroupMask_next(match)) & mask]; \
+			if(eq_fn(slot->key, key)) { \
+				return slot; \
+			} \
+		} \
+		if(StremGroup_match_empty(group) != 0) { \
+			return NULL; \
+		} \
+		index = (index + STREM_GROUP_WIDTH) & mask; \
+	} \
+} \
+\
+/* Returns index of the first empty or dead slot in hash's probe sequence */ \
+static inline size_t name##_free_index_(name* t, size_t hash) { \
+	const size_t mask = t->cap - 1; \
+	size_t index = StremGen_home(hash, t->shift); \
+\
+	while(true) { \
+		const StremGroupMask free = StremGroup_match_free(t->ctrl + index); \
+		if(free != 0) { \
+			return (index + StremGroupMask_next(free)) & mask; \
+		} \
+		index = (index + STREM_GROUP_WIDTH) & mask; \
+	} \
+} \
+\
+/* Returns the first empty or dead slot and takes it */ \
+static inline SlotT* name##_take_(name* t, size_t hash) { \
+	const size_t index = name##_free_index_(t, hash); \
+	if(t->ctrl[index] == STREM_CTRL_DEAD) { \
+		t->tombstones--; \
+	} \
+	StremGroup_set(t->ctrl, t->cap, index, StremGroup_tag(hash)); \
+	return &t->slots[index]; \
+} \
+\
+/* Rehashes slots in place at the same capacity, dropping dead ones. \
+ * Taken slots are marked dead first, then each is moved to the first free slot \
+ * of its probe sequence, swapping with a slot there that isn't placed yet. */ \
+static inline void name##_purge(name* t) { \
+	for(size_t i = 0; i < t->cap; i++) { \
+		StremGroup_set(t->ctrl, t->cap, i, t->ctrl[i] < STREM_CTRL_EMPTY ? STREM_CTRL_DEAD : STREM_CTRL_EMPTY); \
+	} \
+\
+	for(size_t i = 0; i < t->cap;) { \
+		if(t->ctrl[i] != STREM_CTRL_DEAD) { \
+			i++; \
+			continue; \
+		} \
+\
+		const size_t hash = hash_fn(t->slots[i].key); \
+		const size_t index = name##_free_index_(t, hash); \
+		if(index == i) { \
+			i++; \
+		} else if(t->ctrl[index] == STREM_CTRL_EMPTY) { \
+			t->slots[index] = t->slots[i]; \
+			StremGroup_set(t->ctrl, t->cap, i, STREM_CTRL_EMPTY); \
+			i++; \
+		} else { \
+			/* slot i now holds the displaced one, it's placed on the next pass */ \
+			const SlotT displaced = t->slots[index]; \
+			t->slots[index] = t->slots[i]; \
+			t->slots[i] = displaced; \
+		} \
+		StremGroup_set(t->ctrl, t->cap, index, StremGroup_tag(hash)); \
+	} \
+	t->tombstones = 0; \
+} \
+\
+/* Must: newcap is a power of two. Returns false and keeps table if can't allocate */ \
+static inline bool name##_resize(name* t, size_t newcap) { \
+	if(newcap <= t->cap) { \
+		return true; \
+	} \
+	SlotT* const newslots = malloc(newcap * sizeof(SlotT)); \
+	uint8_t* const newctrl = StremGen_ctrl_construct(newcap); \
+	if(newslots == NULL || newctrl == NULL) { \
+		free(newslots); \
+		free(newctrl); \
+		return false; \
+	} \
+\
+	SlotT* const oldslots = t->slots; \
+	uint8_t* const oldctrl = t->ctrl; \
+	const size_t oldcap = t->cap; \
+\
+	t->slots = newslots; \
+	t->ctrl = newctrl; \
+	t->cap = newcap; \
+	t->shift = StremGen_shift(newcap); \
+	t->tombstones = 0; \
+	for(size_t i = 0; i < oldcap; i++) { \
+		if(oldctrl[i] < STREM_CTRL_EMPTY) { \
+			*name##_take_(t, hash_fn(oldslots[i].key)) = oldslots[i]; \
+		} \
+	} \
+\
+	free(oldslots); \
+	free(oldctrl); \
+	return true; \
+} \
+\
+/* If fails to allocate, t.slots == NULL */ \
+static inline name name##_construct(void) { \
+	name t = { 0 }; \
+	t.cap = STREM_GEN_DEFAULT_CAP; \
+	t.saturation = default_saturation; \
+	t.shift = StremGen_shift(STREM_GEN_DEFAULT_CAP); \
+	t.slots = malloc(STREM_GEN_DEFAULT_CAP * sizeof(SlotT)); \
+	t.ctrl = StremGen_ctrl_construct(STREM_GEN_DEFAULT_CAP); \
+	if(t.slots == NULL || t.ctrl == NULL) { \
+		free(t.slots); \
+		free(t.ctrl); \
+		t.slots = NULL; \
+		t.ctrl = NULL; \
+	} \
+	return t; \
+} \
+\
+static inline void name##_free(name* t) { \
+	free(t->slots); \
+	free(t->ctrl); \
+	t->slots = NULL; \
+	t->ctrl = NULL; \
+	t->size = 0; \
+	t->tombstones = 0; \
+} \
+\
+/* Dead slots count towards saturation, so every group keeps empty slots ending misses. \
+ * If most of saturation is dead slots, they're purged instead of growing. \
+ * Returns NULL if need and fail to resize. */ \
+static inline SlotT* name##_insert_slot_(name* t, size_t hash) { \
+	if((float)(t->size + t->tombstones) / t->cap >= t->saturation) { \
+		if((float)t->size / t->cap < t->saturation / 2) { \
+			name##_purge(t); \
+		} else if(!name##_resize(t, t->cap * 2)) { \
+			return NULL; \
+		} \
+	} \
+	t->size++; \
+	return name##_take_(t, hash); \
+} \
+\
+/* Slot contents stay intact until the next insert */ \
+static inline SlotT* name##_remove_slot_(name* t, KeyT key) { \
+	SlotT* const slot = name##_find_(t, key, hash_fn(key)); \
+	if(slot == NULL) { \
+		return NULL; \
+	} \
+	StremGroup_set(t->ctrl, t->cap, (size_t)(slot - t->slots), STREM_CTRL_DEAD); \
+	t->size--; \
+	t->tombstones++; \
+	return slot; \
+}
+
+#define STREM_HT_DEFINE(name, KeyT, ValT, hash_fn, eq_fn) \
+\
+typedef struct { \
+	KeyT key; \
+	ValT value; \
+} name##_Slot; \
+\
+typedef struct { \
+	/* private: */ \
+	name##_Slot* slots; \
+	uint8_t* ctrl; \
+	size_t cap; \
+	size_t shift; \
+	size_t size; \
+	size_t tombstones; /* dead slots, they count towards saturation */ \
+	/* public: */ \
+	float saturation; \
+} name; \
+\
+STREM_GEN_PROBING_(name, name##_Slot, KeyT, hash_fn, eq_fn, STREM_GEN_DEFAULT_HT_SATURATION) \
+\
+/* Inserts pair and returns pointer to value contained inside table. \
+ * Returns NULL if need and fail to resize. */ \
+static inline ValT* name##_insert(name* t, KeyT key, ValT value) { \
+	name##_Slot* const slot = name##_insert_slot_(t, hash_fn(key)); \
+	if(slot == NULL) { \
+		return NULL; \
+	} \
+	slot->key = key; \
+	slot->value = value; \
+	return &slot->value; \
+} \
+\
+/* Returns pointer to associated value (NULL if no key found) */ \
+static inline ValT* name##_at(name* t, KeyT key) { \
+	name##_Slot* const slot = name##_find_(t, key, hash_fn(key)); \
+	return slot != NULL ? &slot->value : NULL; \
+} \
+\
+/* Removes the pair and returns ptr to associated value (NULL if no key found). \
+ * Value pointer is valid until the next insert. */ \
+static inline ValT* name##_remove(name* t, KeyT key) { \
+	name##_Slot* const slot = name##_remove_slot_(t, key); \
+	return slot != NULL ? &slot->value : NULL; \
+}
+
+#define STREM_HS_DEFINE(name, KeyT, hash_fn, eq_fn) \
+\
+typedef struct { \
+	KeyT key; \
+} name##_Slot; \
+\
+typedef struct { \
+	/* private: */ \
+	name##_Slot* slots; \
+	uint8_t* ctrl; \
+	size_t cap; \
+	size_t shift; \
+	size_t size; \
+	size_t tombstones; /* dead slots, they count towards saturation */ \
+	/* public: */ \
+	float saturation; \
+} name; \
+\
+STREM_GEN_PROBING_(name, name##_Slot, KeyT, hash_fn, eq_fn, STREM_GEN_DEFAULT_HS_SATURATION) \
+\
+/* Inserts and returns pointer to key inside set. \
+ * Returns NULL if need and fail to resize. */ \
+static inline KeyT* name##_insert(name* t, KeyT key) { \
+	name##_Slot* const slot = name##_insert_slot_(t, hash_fn(key)); \
+	if(slot == NULL) { \
+		return NULL; \
+	} \
+	slot->key = key; \
+	return &slot->key; \
+} \
+\
+/* Returns pointer to key inside set (NULL if no key found) */ \
+static inline KeyT* name##_at(name* t, KeyT key) { \
+	name##_Slot* const slot = name##_find_(t, key, hash_fn(key)); \
+	return slot != NULL ? &slot->key : NULL; \
+} \
+\
+/* Removes the key and returns ptr to just removed key (NULL if no key found). \
+ * Key pointer is valid until the next insert. */ \
+static inline KeyT* name##_remove(name* t, KeyT key) { \
+	name##_Slot* const slot = name##_remove_slot_(t, key); \
+	return slot != NULL ? &slot->key : NULL; \
+}
+
+#endif // STREM_GEN_H_
@@ -0,0 +1,72 @@
+#ifndef STREM_GROUP_H_
+#define STREM_GROUP_H_
+#include <stdint.h>
+#include "strem_common.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Control bytes for group probing: one byte per slot, kept in a separate array.
+// Taken slots store 7 bits of the hash (high bit clear), so empty and dead
+// slots are told apart from taken ones by the high bit alone.
+#define STREM_CTRL_EMPTY ((uint8_t)0x80)
+#define STREM_CTRL_DEAD ((uint8_t)0xFE)
+
+// Slots checked by one probe. Control array holds cap + STREM_GROUP_WIDTH - 1 bytes,
+// the tail mirrors the first bytes, so a group starting near the end needn't wrap.
+#define STREM_GROUP_WIDTH 16
+
+// Bit i is set if i-th control byte of the group matches
+typedef uint32_t StremGroupMask;
+
+#define StremGroupMask_next(mask) ((size_t)__builtin_ctz(mask))
+#define StremGroupMask_drop(mask) ((mask) &= (mask) - 1)
+
+// Folds the whole hash into 7 bits, so keys sharing home slot still get different tags
+static inline uint8_t StremGroup_tag(size_t hash) {
+	uint64_t h = (uint64_t)hash;
+	h ^= h >> 32;
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return (uint8_t)(h & 0x7F);
+}
+
+static inline StremGroupMask StremGroup_match(uint8_t const* group, uint8_t tag) {
+#if defined(__SSE2__)
+	const __m128i ctrl = _mm_loadu_si128((__m128i const*)group);
+	return (StremGroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+#else
+	StremGroupMask mask = 0;
+	for(size_t i = 0; i < STREM_GROUP_WIDTH; i++) {
+		mask |= (StremGroupMask)(group[i] == tag) << i;
+	}
+	return mask;
+#endif
+}
+
+static inline StremGroupMask StremGroup_match_empty(uint8_t const* group) {
+	return StremGroup_match(group, STREM_CTRL_EMPTY);
+}
+
+// Matches both empty and dead slots
+static inline StremGroupMask StremGroup_match_free(uint8_t const* group) {
+#if defined(__SSE2__)
+	return (StremGroupMask)_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)group));
+#else
+	StremGroupMask mask = 0;
+	for(size_t i = 0; i < STREM_GROUP_WIDTH; i++) {
+		mask |= (StremGroupMask)(group[i] >> 7) << i;
+	}
+	return mask;
+#endif
+}
+
+// Sets control byte of slot index, keeping the mirrored tail in sync
+static inline void StremGroup_set(uint8_t* ctrl, size_t cap, size_t index, uint8_t value) {
+	ctrl[index] = value;
+	if(index < STREM_GROUP_WIDTH - 1) {
+		ctrl[cap + index] = value;
+	}
+}
+
+#endif // STREM_GROUP_H_
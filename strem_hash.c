@@ -0,0 +1,175 @@
+#include <string.h>
+#include "strem_hash.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// wyhash secrets
+#define P0 0xA0761D6478BD642Full
+#define P1 0xE7037ED1A0B428DBull
+#define P2 0x8EBC6AF09C88C6E3ull
+#define P3 0x589965CC75374CC3ull
+
+static uint64_t read64(unsigned char const* bytes) {
+	uint64_t word;
+	memcpy(&word, bytes, sizeof(word));
+	return word;
+}
+
+static uint64_t read32(unsigned char const* bytes) {
+	uint32_t word;
+	memcpy(&word, bytes, sizeof(word));
+	return word;
+}
+
+// Both halves of 128-bit product
+static void mul128(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+	const unsigned __int128 product = (unsigned __int128)*a * *b;
+	*a = (uint64_t)product;
+	*b = (uint64_t)(product >> 64);
+#else
+	const uint64_t a_hi = *a >> 32, a_lo = (uint32_t)*a;
+	const uint64_t b_hi = *b >> 32, b_lo = (uint32_t)*b;
+	const uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+	const uint64_t mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh;
+	*a = (mid << 32) | (uint32_t)ll;
+	*b = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+#endif
+}
+
+// Folds 128-bit product of a and b to 64 bits
+static uint64_t mix(uint64_t a, uint64_t b) {
+	mul128(&a, &b);
+	return a ^ b;
+}
+
+// Inlined into fixed-length kernels, so branches on length are folded away
+static inline uint64_t hash_bytes(unsigned char const* bytes, size_t length) {
+	uint64_t seed = mix(P0 ^ P1, P0);
+	uint64_t a, b;
+
+	if(length <= 16) {
+		if(length >= 4) {
+			const size_t mid = (length >> 3) << 2;
+			a = (read32(bytes) << 32) | read32(bytes + mid);
+			b = (read32(bytes + length - 4) << 32) | read32(bytes + length - 4 - mid);
+		} else if(length > 0) {
+			a = ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[length >> 1] << 8) | bytes[length - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t left = length;
+		if(left > 48) {
+			uint64_t seed1 = seed, seed2 = seed;
+			do {
+				seed = mix(read64(bytes) ^ P1, read64(bytes + 8) ^ seed);
+				seed1 = mix(read64(bytes + 16) ^ P2, read64(bytes + 24) ^ seed1);
+				seed2 = mix(read64(bytes + 32) ^ P3, read64(bytes + 40) ^ seed2);
+				bytes += 48;
+				left -= 48;
+			} while(left > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while(left > 16) {
+			seed = mix(read64(bytes) ^ P1, read64(bytes + 8) ^ seed);
+			bytes += 16;
+			left -= 16;
+		}
+		a = read64(bytes + left - 16);
+		b = read64(bytes + left - 8);
+	}
+
+	a ^= P1;
+	b ^= seed;
+	mul128(&a, &b);
+	return mix(a ^ P0 ^ length, b ^ P1);
+}
+
+#if defined(__SSE2__)
+static inline bool equal_bytes(void const* a, void const* b, size_t length) {
+	__m128i diff = _mm_setzero_si128();
+	for(size_t i = 0; i < length; i += 16) {
+		const __m128i x = _mm_loadu_si128((__m128i const*)((char const*)a + i));
+		const __m128i y = _mm_loadu_si128((__m128i const*)((char const*)b + i));
+		diff = _mm_or_si128(diff, _mm_xor_si128(x, y));
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xFFFF;
+}
+#else
+static inline bool equal_bytes(void const* a, void const* b, size_t length) {
+	uint64_t diff = 0;
+	for(size_t i = 0; i < length; i += 8) {
+		diff |= read64((unsigned char const*)a + i) ^ read64((unsigned char const*)b + i);
+	}
+	return diff == 0;
+}
+#endif
+
+size_t StremHash_bytes(void const* bytes, size_t length) {
+	return (size_t)hash_bytes(bytes, length);
+}
+
+size_t StremHash_u32(void const* key) {
+	return (size_t)mix(read32(key) ^ P0, P1);
+}
+
+size_t StremHash_u64(void const* key) {
+	return (size_t)mix(read64(key) ^ P0, P1);
+}
+
+size_t StremHash_16(void const* key) {
+	return (size_t)hash_bytes(key, 16);
+}
+
+size_t StremHash_32(void const* key) {
+	return (size_t)hash_bytes(key, 32);
+}
+
+size_t StremHash_64(void const* key) {
+	return (size_t)hash_bytes(key, 64);
+}
+
+bool StremCmp_u32(void const* a, void const* b) {
+	return read32(a) == read32(b);
+}
+
+bool StremCmp_u64(void const* a, void const* b) {
+	return read64(a) == read64(b);
+}
+
+bool StremCmp_16(void const* a, void const* b) {
+	return equal_bytes(a, b, 16);
+}
+
+bool StremCmp_32(void const* a, void const* b) {
+	return equal_bytes(a, b, 32);
+}
+
+bool StremCmp_64(void const* a, void const* b) {
+	return equal_bytes(a, b, 64);
+}
+
+StremHashFunction StremHash_for_size(size_t key_size) {
+	switch(key_size) {
+	case 4: return StremHash_u32;
+	case 8: return StremHash_u64;
+	case 16: return StremHash_16;
+	case 32: return StremHash_32;
+	case 64: return StremHash_64;
+	default: return NULL;
+	}
+}
+
+StremCmpFunction StremCmp_for_size(size_t key_size) {
+	switch(key_size) {
+	case 4: return StremCmp_u32;
+	case 8: return StremCmp_u64;
+	case 16: return StremCmp_16;
+	case 32: return StremCmp_32;
+	case 64: return StremCmp_64;
+	default: return NULL;
+	}
+}
@@ -0,0 +1,35 @@
+#ifndef STREM_HASH_H_
+#define STREM_HASH_H_
+#include <stdint.h>
+#include "strem_common.h"
+
+typedef size_t(*StremHashFunction)(void const*);
+typedef bool(*StremCmpFunction)(void const*, void const*);
+
+// Built-in kernels, picked by hash containers by key_size when func or cmp_func is NULL.
+// Hashes are mixed over all 64 bits, so they fit any index policy.
+
+// wyhash-style hash of length bytes: 16 bytes per 128-bit multiply, 48 for long keys
+size_t StremHash_bytes(void const* bytes, size_t length);
+
+// Single multiply-fold finalizers of integer keys
+size_t StremHash_u32(void const* key);
+size_t StremHash_u64(void const* key);
+// StremHash_bytes unrolled for fixed length
+size_t StremHash_16(void const* key);
+size_t StremHash_32(void const* key);
+size_t StremHash_64(void const* key);
+
+// Equality of fixed-size keys, compared 16 bytes at once with SSE2 if available
+bool StremCmp_u32(void const* a, void const* b);
+bool StremCmp_u64(void const* a, void const* b);
+bool StremCmp_16(void const* a, void const* b);
+bool StremCmp_32(void const* a, void const* b);
+bool StremCmp_64(void const* a, void const* b);
+
+// Kernel for keys of key_size bytes, NULL if there's none:
+// containers then use StremHash_bytes and memcmp
+StremHashFunction StremHash_for_size(size_t key_size);
+StremCmpFunction StremCmp_for_size(size_t key_size);
+
+#endif // STREM_HASH_H_
@@ -1,148 +1,360 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 #include "strem_hs.h"
+#include "strem_group.h"
+#include "strem_index.h"
 
 #define KEYSIZE(hs) (sizeof(StremHSKey) + (hs).key_size)
+// size_t-aligned VLA big enough for one key of hs
+#define KEYBUF(name, hs) size_t name[(KEYSIZE(hs) + sizeof(size_t) - 1) / sizeof(size_t)]
+// Key copied by insert_bulk: hash, key
+#define TUPLESIZE(hs) ((sizeof(size_t) + (hs).key_size + sizeof(size_t) - 1) \
+	/ sizeof(size_t) * sizeof(size_t))
 
 #define DEFAULT_HS_CAP 32
 #define DEFAULT_HS_SATURATION 0.5f
-#define GAP 5
-// number of keys in collision chain including the tail one, which may not collide
-#define COLLISION_MAX_LENGTH 5
+// keys hashed and prefetched ahead of probing by at_batch
+#define BATCH_CHUNK 32
+// buckets of home slots insert_bulk sorts keys into, at most;
+// few enough for scattering to keep its write targets in cache
+#define BULK_BUCKETS ((size_t)1 << 12)
+// keys placed by one thread of insert_bulk are never fewer
+#define BULK_THREAD_ROWS 4096
+// threads started by insert_bulk and set operations, at most
+#define MAX_THREADS 64
 
 typedef enum {
 	GROW_LEFT,
 	GROW_RIGHT,
 	GROW_MALLOC,
+	GROW_VIEW, /* keys are in snapshot, never grown or freed */
 } GROW_MODE;
 
 static StremHSKey* get_key(StremHashSet* hs, size_t index) {
 	return (StremHSKey*)((char*)hs->keys + KEYSIZE(*hs) * index);
 }
 
-// returns length of collision chain including the tail one which may not collide
-// returns 0 if any other key in chain is on its needed place
-static size_t get_collision_chain(
-	StremHashSet* hs,
-	StremHSKey* start_key, 
-	StremHSKey* col_stack[COLLISION_MAX_LENGTH]
-) {
-	const size_t keys_cap = hs->cap;
-	size_t col_len = 0;
-	StremHSKey* key = start_key;
-	StremHSKey* new_key = get_key(hs, key->hash % keys_cap);
+static size_t home_index(StremHashSet* hs, size_t hash) {
+	return StremIndex_home(hash, hs->cap, hs->index_policy);
+}
+
+// stride is 1 for slots, STREM_GROUP_WIDTH for groups
+static size_t probe_index(StremHashSet* hs, size_t index, size_t probe, size_t stride) {
+	return StremIndex_next(index, probe, hs->cap, hs->index_policy, hs->probe_seq, stride);
+}
 
-	for(;new_key->type == STREM_HS_TAKEN && col_len < COLLISION_MAX_LENGTH - 1; col_len++) {
-		if(key == new_key) {
-			return 0;
+// Built-in hash of key_size bytes if there's no func for them
+static size_t hash_key(StremHashSet* hs, void const* key) {
+	return hs->func != NULL ? hs->func(key) : StremHash_bytes(key, hs->key_size);
+}
+
+static bool cmp_keys(StremHashSet* hs, void const* a, void const* b) {
+	return hs->cmp_func != NULL ? hs->cmp_func(a, b) : memcmp(a, b, hs->key_size) == 0;
+}
+
+// Compares stored hash first, cmp_func is called only if hashes match
+static bool keys_equal(StremHashSet* hs, StremHSKey* hs_key, void const* key, size_t hash) {
+	if(hash != hs_key->hash) {
+		return false;
+	}
+	STREM_COUNT(hs, cmp_calls, 1);
+	return cmp_keys(hs, hs_key->content, key);
+}
+
+static uint8_t* ctrl_construct(StremAllocator const* allocator, size_t cap) {
+	uint8_t* const ctrl = StremAllocator_alloc(allocator, cap + STREM_GROUP_WIDTH - 1);
+	if(ctrl != NULL) {
+		memset(ctrl, STREM_CTRL_EMPTY, cap + STREM_GROUP_WIDTH - 1);
+	}
+	return ctrl;
+}
+
+// Returns index of the first empty or dead slot in hash's probe sequence
+static size_t free_index(StremHashSet* hs, size_t hash) {
+	size_t index = home_index(hs, hash);
+
+	if(hs->mode == STREM_HS_GROUP) {
+		for(size_t probe = 1;; probe++) {
+			const StremGroupMask free = StremGroup_match_free(hs->ctrl + index);
+			if(free != 0) {
+				index += StremGroupMask_next(free);
+				return index < hs->cap ? index : index - hs->cap;
+			}
+			index = probe_index(hs, index, probe, STREM_GROUP_WIDTH);
 		}
+	}
+
+	for(size_t probe = 1; get_key(hs, index)->type == STREM_HS_TAKEN; probe++) {
+		index = probe_index(hs, index, probe, 1);
+	}
+	return index;
+}
 
-		col_stack[col_len] = key;
-		col_stack[col_len + 1] = new_key;
-		key = new_key;
-		new_key = get_key(hs, key->hash % keys_cap);
+static void take_slot(StremHashSet* hs, size_t index, size_t hash) {
+	if(hs->mode == STREM_HS_GROUP) {
+		StremGroup_set(hs->ctrl, hs->cap, index, StremGroup_tag(hash));
 	}
+}
 
-	return col_len + 1; // + 1 is the last added new_key which may not collide 
+static size_t next_index(StremHashSet* hs, size_t index) {
+	return index + 1 == hs->cap ? 0 : index + 1;
 }
 
-// collision chain consists of pointers to keys including the tail one which may not collide
-// function shifts the chain, copying each key to the location of next key
-static void resolve_collision_chain(
-	StremHSKey* col_stack[COLLISION_MAX_LENGTH],
-	size_t key_size_with_content,
-	size_t col_len
-) {
-	if(col_len < 2) {
-		return;
+// Robin hood insertion: walking from index, where key is key->psl slots from home,
+// key takes place of the first key which is closer to its own home,
+// the displaced key continues the walk.
+// Uses key as a scratch buffer, returns slot where key is placed.
+static StremHSKey* place_robin_hood_at(StremHashSet* hs, StremHSKey* key, size_t index) {
+	const size_t key_size = KEYSIZE(*hs);
+	KEYBUF(swap_buf, *hs);
+	StremHSKey* placed = NULL;
+
+	while(true) {
+		StremHSKey* const hs_key = get_key(hs, index);
+
+		if(hs_key->type != STREM_HS_TAKEN) {
+			memcpy(hs_key, key, key_size);
+			return placed != NULL ? placed : hs_key;
+		}
+		if(hs_key->psl < key->psl) {
+			memcpy(swap_buf, hs_key, key_size);
+			memcpy(hs_key, key, key_size);
+			memcpy(key, swap_buf, key_size);
+			if(placed == NULL) {
+				placed = hs_key;
+			}
+		}
+
+		index = next_index(hs, index);
+		key->psl++;
 	}
-	for(col_len -= 2; col_len != 0; col_len--) {
-		memcpy(col_stack[col_len + 1], col_stack[col_len], key_size_with_content);
+}
+
+// Robin hood insertion walking from home slot
+static StremHSKey* place_robin_hood(StremHashSet* hs, StremHSKey* key) {
+	key->psl = 0;
+	return place_robin_hood_at(hs, key, home_index(hs, key->hash));
+}
+
+// Copies taken key into set, key may be clobbered. Returns slot where key is placed.
+static StremHSKey* place_key(StremHashSet* hs, StremHSKey* key) {
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		return place_robin_hood(hs, key);
 	}
-	col_stack[0]->type = STREM_HS_EMPTY;
+
+	const size_t index = free_index(hs, key->hash);
+	StremHSKey* const hs_key = get_key(hs, index);
+	memcpy(hs_key, key, KEYSIZE(*hs));
+	take_slot(hs, index, key->hash);
+	return hs_key;
 }
 
-bool StremHashSet_resize(StremHashSet* hs, size_t newcap) {
-	void* oldkeys_start = hs->keys;
+// Sets with other than linear mode and default policy are malloced only,
+// so they're rehashed into fresh arrays
+static bool resize_rehash(StremHashSet* hs, size_t newcap) {
+	const size_t key_size = KEYSIZE(*hs);
+	void* const newkeys = StremAllocator_calloc(hs->allocator, key_size, newcap);
+	uint8_t* const newctrl = hs->mode == STREM_HS_GROUP ? ctrl_construct(hs->allocator, newcap) : NULL;
+	if(newkeys == NULL || (hs->mode == STREM_HS_GROUP && newctrl == NULL)) {
+		StremAllocator_free(hs->allocator, newkeys);
+		StremAllocator_free(hs->allocator, newctrl);
+		return false;
+	}
+
+	void* const oldkeys = hs->keys;
+	uint8_t* const oldctrl = hs->ctrl;
+	const size_t oldcap = hs->cap;
+
+	hs->keys = newkeys;
+	hs->ctrl = newctrl;
+	hs->cap = newcap;
+
+	for(size_t i = 0; i < oldcap; i++) {
+		StremHSKey* const key = (StremHSKey*)((char*)oldkeys + key_size*i);
+		if(key->type != STREM_HS_TAKEN) {
+			continue;
+		}
+
+		place_key(hs, key);
+	}
+
+	StremAllocator_free(hs->allocator, oldkeys);
+	StremAllocator_free(hs->allocator, oldctrl);
+	hs->tombstones = 0;
+	return true;
+}
+
+// Rehashes keys in place, dropping dead slots.
+// Taken keys are marked dead first, then each is moved to the first free slot
+// of its probe sequence, swapping with a key there that isn't placed yet.
+// Slots before a placed key in its sequence are taken by placed keys, so they stay taken.
+static void rehash_in_place(StremHashSet* hs) {
+	const size_t key_size = KEYSIZE(*hs);
+	KEYBUF(swap_buf, *hs);
+
+	for(size_t i = 0; i < hs->cap; i++) {
+		StremHSKey* const hs_key = get_key(hs, i);
+		hs_key->type = hs_key->type == STREM_HS_TAKEN ? STREM_HS_DEAD : STREM_HS_EMPTY;
+		if(hs->mode == STREM_HS_GROUP) {
+			StremGroup_set(hs->ctrl, hs->cap, i, hs_key->type == STREM_HS_DEAD ? STREM_CTRL_DEAD : STREM_CTRL_EMPTY);
+		}
+	}
+
+	for(size_t i = 0; i < hs->cap;) {
+		StremHSKey* const hs_key = get_key(hs, i);
+		if(hs_key->type != STREM_HS_DEAD) {
+			i++;
+			continue;
+		}
+
+		const size_t index = free_index(hs, hs_key->hash);
+		StremHSKey* const new_key = get_key(hs, index);
+		if(index == i) {
+			i++;
+		} else if(new_key->type == STREM_HS_EMPTY) {
+			memcpy(new_key, hs_key, key_size);
+			hs_key->type = STREM_HS_EMPTY;
+			if(hs->mode == STREM_HS_GROUP) {
+				StremGroup_set(hs->ctrl, hs->cap, i, STREM_CTRL_EMPTY);
+			}
+			i++;
+		} else {
+			/* slot i now holds the displaced key, it's placed on the next pass */
+			memcpy(swap_buf, new_key, key_size);
+			memcpy(new_key, hs_key, key_size);
+			memcpy(hs_key, swap_buf, key_size);
+		}
+		new_key->type = STREM_HS_TAKEN;
+		take_slot(hs, index, new_key->hash);
+	}
+	hs->tombstones = 0;
+}
+
+// Linear sets grow in place: new slots are cleared, then keys are rehashed among all of them
+static bool resize_keys(StremHashSet* hs, size_t newcap) {
 	const size_t oldcap = hs->cap;
 	const size_t key_size = KEYSIZE(*hs);
 	
 	if(newcap <= oldcap) {
 		return true;
+	} else if(hs->grow_mode == (int)GROW_VIEW) {
+		return false;
+	} else if(hs->mode != STREM_HS_LINEAR
+		|| hs->index_policy != STREM_INDEX_MODULO
+		|| hs->probe_seq != STREM_SEQ_GAP
+	) {
+		return resize_rehash(hs, newcap);
 	} else if(hs->grow_mode == (int)GROW_MALLOC) {
-		void* const newkeys = realloc(hs->keys, newcap*key_size);
+		void* const newkeys = StremAllocator_realloc(hs->allocator, hs->keys, newcap*key_size);
 		if(newkeys == NULL) {
 			return false;
 		}
 		hs->keys = newkeys;
-		oldkeys_start = hs->keys;
+		memset((char*)hs->keys + oldcap*key_size, 0, (newcap - oldcap)*key_size);
 	} else if(hs->grow_mode == (int)GROW_LEFT) {
 		if((char*)hs->keys <= (char*)NULL + newcap*key_size) { /* is it really needed? */
 			return false;
 		}
 		hs->keys = (char*)hs->keys - (newcap - oldcap)*key_size;
+		memset(hs->keys, 0, (newcap - oldcap)*key_size);
+	} else {
+		memset((char*)hs->keys + oldcap*key_size, 0, (newcap - oldcap)*key_size);
 	}
 	hs->cap = newcap;
 
-	StremHSKey* collision_stack[COLLISION_MAX_LENGTH];
-//	char* const collided_key_buf = malloc(sizeof(char)*key_size);
-	char collided_key_buf[key_size]; // VLA
-	bool key_buf_empty = true;
+	rehash_in_place(hs);
+	return true;
+}
 
-	for(size_t i = 0; i < oldcap; i++) {
-		/* don't use get_key here in case of GROW_LEFT */
-		StremHSKey* key = (StremHSKey*)((char*)oldkeys_start + KEYSIZE(*hs)*i);
-		if(key->type != STREM_HS_TAKEN) {
-			continue;
-		}
+static StremHSKey* key_at_group(StremHashSet* hs, void const* key, size_t hash) {
+	const uint8_t tag = StremGroup_tag(hash);
+	size_t index = home_index(hs, hash);
 
-		const size_t new_index = key->hash % newcap;
-		StremHSKey* const new_key = get_key(hs, new_index);
+	/* Tag match = check hashes and cmp
+	 * No match, but group has empty slot = return null
+	 * Otherwise continue with the next group
+	 */
+	for(size_t probe = 1;; probe++) {
+		uint8_t const* const group = hs->ctrl + index;
+		STREM_COUNT(hs, probes, 1);
 
-		if(new_index == i) {
-			continue;
-		} else if(new_key->type != STREM_HS_TAKEN) {
-			memcpy(new_key, key, key_size);
-			continue;
-		}
+		for(StremGroupMask match = StremGroup_match(group, tag); match != 0; StremGroupMask_drop(match)) {
+			size_t key_index = index + StremGroupMask_next(match);
+			key_index = key_index < hs->cap ? key_index : key_index - hs->cap;
 
-		size_t col_len = COLLISION_MAX_LENGTH + 1;
-		StremHSKey* const collision_start = key;
+			StremHSKey* const hs_key = get_key(hs, key_index);
+			if(keys_equal(hs, hs_key, key, hash)) {
+				return hs_key;
+			}
+		}
+		if(StremGroup_match_empty(group) != 0) {
+			return NULL;
+		}
+		index = probe_index(hs, index, probe, STREM_GROUP_WIDTH);
+	}
+}
 
-		while(col_len >= COLLISION_MAX_LENGTH) {
-			col_len = get_collision_chain(hs, key, collision_stack);
+static StremHSKey* key_at_robin_hood(StremHashSet* hs, void const* key, size_t hash) {
+	size_t index = home_index(hs, hash);
 
-			if(col_len == 0) {
-				/* if 0, a key on its dedicated slot is met.
-				 * In this case, we can't rehash keys in chain.
-				 *
-				 * If chain was long enough for 2+ iterations,
-				 * buffed key is placed in the beginning of chain.
-				 */ 
-				if(!key_buf_empty) {
-					memcpy(collision_start, collided_key_buf, key_size);
-				}
-				break;
-			}
-			if(col_len == COLLISION_MAX_LENGTH) {
-				memcpy(collided_key_buf, collision_stack[col_len - 1], key_size);
-				key = (StremHSKey*)collided_key_buf;
-				key_buf_empty = false;
-			}
+	/* Empty = return null
+	 * Key closer to its home than we are to ours = return null,
+	 * 	insertion would have taken its place
+	 * Otherwise check hashes and cmp
+	 */
+	for(unsigned int psl = 0;; psl++) {
+		StremHSKey* const hs_key = get_key(hs, index);
+		STREM_COUNT(hs, probes, 1);
 
-			resolve_collision_chain(collision_stack, KEYSIZE(*hs), col_len);
+		if(hs_key->type != STREM_HS_TAKEN || hs_key->psl < psl) {
+			return NULL;
 		}
-		
+		if(keys_equal(hs, hs_key, key, hash)) {
+			return hs_key;
+		}
+		index = next_index(hs, index);
 	}
-	
-//	free(collided_key_buf);
-	return true;
 }
 
-static StremHSKey* key_at(StremHashSet* hs, void const* key) {
-	const size_t hash = hs->func(key);
-	size_t index = hash % hs->cap;
+// Shifts keys following the removed one back by one slot until a key on its home slot.
+// Removed key is copied to the slot freed at the end of chain, which is returned.
+static StremHSKey* remove_backward_shift(StremHashSet* hs, StremHSKey* hs_key) {
+	const size_t key_size = KEYSIZE(*hs);
+	KEYBUF(removed_buf, *hs);
+	size_t index = ((char*)hs_key - (char*)hs->keys) / key_size;
+	StremHSKey* next_key = get_key(hs, next_index(hs, index));
+
+	memcpy(removed_buf, hs_key, key_size);
+	while(next_key->type == STREM_HS_TAKEN && next_key->psl != 0) {
+		memcpy(hs_key, next_key, key_size);
+		hs_key->psl--;
+
+		index = next_index(hs, index);
+		hs_key = next_key;
+		next_key = get_key(hs, next_index(hs, index));
+	}
+	memcpy(hs_key, removed_buf, key_size);
+	hs_key->type = STREM_HS_EMPTY;
+	return hs_key;
+}
+
+static StremHSKey* key_at_hashed(StremHashSet* hs, void const* key, size_t hash) {
+	STREM_COUNT(hs, lookups, 1);
+	if(hs->bloom != NULL
+		&& !StremBloom_may_contain(StremBloom_block(hs->bloom, hs->bloom_blocks, hash), hash)
+	) {
+		return NULL;
+	}
+
+	if(hs->mode == STREM_HS_GROUP) {
+		return key_at_group(hs, key, hash);
+	} else if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		return key_at_robin_hood(hs, key, hash);
+	}
+
+	size_t index = home_index(hs, hash);
 	StremHSKey* hs_key = get_key(hs, index);
 
 	/* Dead = continue
@@ -154,15 +366,16 @@ static StremHSKey* key_at(StremHashSet* hs, void const* key) {
 	 * 		if cmp == then return ptr
 	 */
 	// using index and hs_key separately for clarity
-	while(true) {
+	for(size_t probe = 1;; probe++) {
+		STREM_COUNT(hs, probes, 1);
 		if(hs_key->type == STREM_HS_EMPTY) {
 			return NULL;
 		}
 		if(hs_key->type == STREM_HS_DEAD
 		|| (hs_key->type == STREM_HS_TAKEN 
-			&& (hash != hs_key->hash || !hs->cmp_func(hs_key->content, key))
+			&& !keys_equal(hs, hs_key, key, hash)
 		)) {
-			index = (index + GAP) % hs->cap;
+			index = probe_index(hs, index, probe, 1);
 			hs_key = get_key(hs, index);
 		} else {
 			return hs_key;
@@ -170,19 +383,120 @@ static StremHSKey* key_at(StremHashSet* hs, void const* key) {
 	}
 }
 
+// (Re)builds filter for current capacity, drops it if fails to allocate
+static bool bloom_build(StremHashSet* hs) {
+	const size_t blocks = StremBloom_blocks(hs->cap);
+
+	/* aligned to cache line unless allocator is custom */
+	StremAllocator_free(hs->allocator, hs->bloom);
+	hs->bloom = hs->allocator == NULL
+		? aligned_alloc(sizeof(StremBloomBlock), blocks * sizeof(StremBloomBlock))
+		: StremAllocator_alloc(hs->allocator, blocks * sizeof(StremBloomBlock));
+	if(hs->bloom == NULL) {
+		hs->bloom_blocks = 0;
+		return false;
+	}
+	memset(hs->bloom, 0, blocks * sizeof(StremBloomBlock));
+	hs->bloom_blocks = blocks;
+
+	for(size_t i = 0; i < hs->cap; i++) {
+		StremHSKey* const key = get_key(hs, i);
+		if(key->type == STREM_HS_TAKEN) {
+			StremBloom_add(StremBloom_block(hs->bloom, blocks, key->hash), key->hash);
+		}
+	}
+	return true;
+}
+
+bool StremHashSet_resize(StremHashSet* hs, size_t newcap) {
+	const size_t oldcap = hs->cap;
+	if(!resize_keys(hs, newcap)) {
+		return false;
+	}
+	if(hs->cap != oldcap) {
+		hs->resizes++;
+	}
+
+	if(hs->bloom != NULL && hs->cap != oldcap) {
+		bloom_build(hs);
+	}
+	return true;
+}
+
+void StremHashSet_purge(StremHashSet* hs) {
+	/* robin hood sets never leave dead slots */
+	if(hs->grow_mode != (int)GROW_VIEW && hs->mode != STREM_HS_ROBIN_HOOD && hs->tombstones != 0) {
+		rehash_in_place(hs);
+	}
+}
+
+bool StremHashSet_enable_bloom(StremHashSet* hs) {
+	return bloom_build(hs);
+}
+
 StremHashSet StremHashSet_construct(
 	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func
 ) {
-	return (StremHashSet){
-		calloc((sizeof(StremHSKey) + key_size), DEFAULT_HS_CAP),
-		func,
-		cmp_func,
+	return StremHashSet_construct_mode(key_size, func, cmp_func, STREM_HS_LINEAR);
+}
+
+StremHashSet StremHashSet_construct_mode(
+	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func, StremHSMode mode
+) {
+	return StremHashSet_construct_policy(
+		key_size, func, cmp_func, mode, STREM_INDEX_MODULO, STREM_SEQ_GAP
+	);
+}
+
+StremHashSet StremHashSet_construct_policy(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHSMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq
+) {
+	return StremHashSet_construct_with(key_size, func, cmp_func, mode, index_policy, probe_seq, NULL);
+}
+
+StremHashSet StremHashSet_construct_with(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHSMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq,
+	StremAllocator const* allocator
+) {
+	assert((probe_seq != STREM_SEQ_TRIANGULAR || index_policy == STREM_INDEX_MASK)
+		&& "Triangular probing visits every slot only in power-of-two set");
+	assert(StremIndex_is_pow2(DEFAULT_HS_CAP));
+	StremHashSet hs = {
+		StremAllocator_calloc(allocator, (sizeof(StremHSKey) + key_size), DEFAULT_HS_CAP),
+		NULL,
+		func != NULL ? func : StremHash_for_size(key_size),
+		cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size),
 		DEFAULT_HS_CAP,
 		0,
+		0,
 		key_size,
 		DEFAULT_HS_SATURATION,
-		(int)GROW_MALLOC
+		(int)GROW_MALLOC,
+		(int)mode,
+		(int)index_policy,
+		(int)probe_seq,
+		NULL,
+		0,
+		allocator,
+		0,
+		{ 0 }
 	};
+
+	if(mode == STREM_HS_GROUP && (hs.ctrl = ctrl_construct(allocator, DEFAULT_HS_CAP)) == NULL) {
+		StremAllocator_free(allocator, hs.keys);
+		hs.keys = NULL;
+	}
+	return hs;
 }
 StremHashSet StremHashSet_emplace(
 	void* at, size_t at_buf_size, size_t key_size, StremHashFunction func, 
@@ -194,44 +508,559 @@ StremHashSet StremHashSet_emplace(
 	memset(at, 0, at_buf_size);
 	return (StremHashSet){
 		at,
-		func,
-		cmp_func,
+		NULL,
+		func != NULL ? func : StremHash_for_size(key_size),
+		cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size),
 		cap,
 		0,
+		0,
 		key_size,
 		DEFAULT_HS_SATURATION,
-		grow_left ? GROW_LEFT : GROW_RIGHT
+		grow_left ? GROW_LEFT : GROW_RIGHT,
+		(int)STREM_HS_LINEAR,
+		(int)STREM_INDEX_MODULO,
+		(int)STREM_SEQ_GAP,
+		NULL,
+		0,
+		NULL,
+		0,
+		{ 0 }
 	};
 }
 void StremHashSet_free(StremHashSet* hs) {
+	StremAllocator_free(hs->allocator, hs->bloom);
+	if(hs->grow_mode == GROW_VIEW) {
+		hs->keys = NULL;
+		hs->ctrl = NULL;
+		hs->bloom = NULL;
+		return;
+	}
 	if(hs->grow_mode == GROW_MALLOC) {
-		free(hs->keys);
+		StremAllocator_free(hs->allocator, hs->keys);
 	}
+	StremAllocator_free(hs->allocator, hs->ctrl);
+	hs->ctrl = NULL;
+	hs->bloom = NULL;
+	hs->bloom_blocks = 0;
 }
 
-void* StremHashSet_insert(StremHashSet* hs, void const* const key) {
-	const float current_satur = (float)hs->size / hs->cap;
+bool StremHashSet_snapshot_write(StremHashSet* hs, FILE* file, uint64_t hash_seed) {
+	const uint64_t keys_bytes = (uint64_t)hs->cap * KEYSIZE(*hs);
+	const uint64_t ctrl_bytes = hs->mode == STREM_HS_GROUP ? hs->cap + STREM_GROUP_WIDTH - 1 : 0;
+	StremSnapshotHeader header = { 0 };
+
+	memcpy(header.magic, STREM_SNAPSHOT_HS_MAGIC, sizeof(header.magic));
+	header.version = STREM_SNAPSHOT_VERSION;
+	header.slot_header_size = sizeof(StremHSKey);
+	header.hash_seed = hash_seed;
+	header.key_size = hs->key_size;
+	header.value_size = 0;
+	header.cap = hs->cap;
+	header.size = hs->size;
+	header.mode = (uint32_t)hs->mode;
+	header.index_policy = (uint32_t)hs->index_policy;
+	header.probe_seq = (uint32_t)hs->probe_seq;
+	header.keys_offset = StremSnapshot_align(sizeof(header));
+	header.ctrl_offset = ctrl_bytes != 0 ? StremSnapshot_align(header.keys_offset + keys_bytes) : 0;
+	header.values_offset = 0;
+	header.total_size = ctrl_bytes != 0 ? header.ctrl_offset + ctrl_bytes : header.keys_offset + keys_bytes;
+
+	return fwrite(&header, sizeof(header), 1, file) == 1
+		&& StremSnapshot_pad(file, sizeof(header), header.keys_offset)
+		&& fwrite(hs->keys, 1, keys_bytes, file) == keys_bytes
+		&& (ctrl_bytes == 0
+			|| (StremSnapshot_pad(file, header.keys_offset + keys_bytes, header.ctrl_offset)
+				&& fwrite(hs->ctrl, 1, ctrl_bytes, file) == ctrl_bytes));
+}
+
+StremHashSet StremHashSet_snapshot_view(
+	void const* buf,
+	size_t buf_size,
+	uint64_t hash_seed,
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+) {
+	StremSnapshotHeader const* const header = buf;
+	StremHashSet hs = { 0 };
+
+	if(!StremSnapshot_valid(
+		header, buf_size, STREM_SNAPSHOT_HS_MAGIC, sizeof(StremHSKey), hash_seed, key_size, 0
+	) || header->mode > STREM_HS_ROBIN_HOOD
+		|| header->size >= header->cap
+		|| !StremIndex_valid((size_t)header->cap, header->index_policy, header->probe_seq)
+		|| (header->mode == STREM_HS_GROUP
+			&& (header->ctrl_offset == 0
+				|| header->ctrl_offset + header->cap + STREM_GROUP_WIDTH - 1 > header->total_size))
+	) {
+		return hs;
+	}
+
+	/* view is never written, const is dropped only to fit the set */
+	hs.keys = (char*)buf + header->keys_offset;
+	hs.ctrl = header->mode == STREM_HS_GROUP ? (uint8_t*)buf + header->ctrl_offset : NULL;
+	hs.func = func != NULL ? func : StremHash_for_size(key_size);
+	hs.cmp_func = cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size);
+	hs.cap = (size_t)header->cap;
+	hs.size = (size_t)header->size;
+	hs.key_size = key_size;
+	hs.saturation = DEFAULT_HS_SATURATION;
+	hs.grow_mode = (int)GROW_VIEW;
+	hs.mode = (int)header->mode;
+	hs.index_policy = (int)header->index_policy;
+	hs.probe_seq = (int)header->probe_seq;
+	return hs;
+}
+
+// Writes new key to free slot index, size and tombstones are left to caller
+static StremHSKey* fill_slot(StremHashSet* hs, size_t index, void const* key, size_t hash) {
+	StremHSKey* const hs_key = get_key(hs, index);
+
+	memcpy(&hs_key->content, key, hs->key_size);
+	hs_key->type = STREM_HS_TAKEN;
+	hs_key->hash = hash;
+	take_slot(hs, index, hash);
+	return hs_key;
+}
+
+// Dead slots count towards saturation, so misses never probe a table full of them.
+// If most of saturation is dead slots, they're purged instead of growing.
+// Returns false if needs and fails to grow.
+static bool prepare_insert(StremHashSet* hs) {
+	const float current_satur = (float)(hs->size + hs->tombstones) / hs->cap;
 	if(current_satur >= hs->saturation) {
-		if(StremHashSet_resize(hs, hs->cap * 2)) {
+		if((float)hs->size / hs->cap < hs->saturation / 2) {
+			StremHashSet_purge(hs);
+		} else if(!StremHashSet_resize(hs, hs->cap * 2)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void* insert_hashed(StremHashSet* hs, void const* key, size_t hash) {
+	if(!prepare_insert(hs)) {
+		return NULL;
+	}
+
+	if(hs->bloom != NULL) {
+		StremBloom_add(StremBloom_block(hs->bloom, hs->bloom_blocks, hash), hash);
+	}
+
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		KEYBUF(new_key_buf, *hs);
+		StremHSKey* const new_key = (StremHSKey*)new_key_buf;
+
+		new_key->hash = hash;
+		new_key->type = STREM_HS_TAKEN;
+		memcpy(&new_key->content, key, hs->key_size);
+		hs->size++;
+
+		return place_robin_hood(hs, new_key)->content;
+	}
+
+	const size_t key_index = free_index(hs, hash);
+	if(get_key(hs, key_index)->type == STREM_HS_DEAD) {
+		hs->tombstones--;
+	}
+	hs->size++;
+
+	return fill_slot(hs, key_index, key, hash)->content;
+}
+
+void* StremHashSet_insert(StremHashSet* hs, void const* const key) {
+	return insert_hashed(hs, key, hash_key(hs, key));
+}
+
+// Looks for key. If not found, returns NULL and sets index (and psl for robin hood)
+// to the place where key should be inserted.
+static StremHSKey* find_or_locate(
+	StremHashSet* hs, void const* key, size_t hash, size_t* at_index, unsigned int* at_psl
+) {
+	size_t index = home_index(hs, hash);
+	size_t free = STREM_SIZE_MAX;
+
+	STREM_COUNT(hs, lookups, 1);
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		for(unsigned int psl = 0;; psl++) {
+			StremHSKey* const hs_key = get_key(hs, index);
+			STREM_COUNT(hs, probes, 1);
+
+			if(hs_key->type != STREM_HS_TAKEN || hs_key->psl < psl) {
+				*at_index = index;
+				*at_psl = psl;
+				return NULL;
+			}
+			if(keys_equal(hs, hs_key, key, hash)) {
+				return hs_key;
+			}
+			index = next_index(hs, index);
+		}
+	} else if(hs->mode == STREM_HS_GROUP) {
+		const uint8_t tag = StremGroup_tag(hash);
+
+		for(size_t probe = 1;; probe++) {
+			uint8_t const* const group = hs->ctrl + index;
+			STREM_COUNT(hs, probes, 1);
+
+			for(StremGroupMask match = StremGroup_match(group, tag); match != 0; StremGroupMask_drop(match)) {
+				size_t key_index = index + StremGroupMask_next(match);
+				key_index = key_index < hs->cap ? key_index : key_index - hs->cap;
+
+				StremHSKey* const hs_key = get_key(hs, key_index);
+				if(keys_equal(hs, hs_key, key, hash)) {
+					return hs_key;
+				}
+			}
+			const StremGroupMask free_mask = StremGroup_match_free(group);
+			if(free == STREM_SIZE_MAX && free_mask != 0) {
+				free = index + StremGroupMask_next(free_mask);
+				free = free < hs->cap ? free : free - hs->cap;
+			}
+			if(StremGroup_match_empty(group) != 0) {
+				*at_index = free;
+				return NULL;
+			}
+			index = probe_index(hs, index, probe, STREM_GROUP_WIDTH);
+		}
+	}
+
+	for(size_t probe = 1;; probe++) {
+		StremHSKey* const hs_key = get_key(hs, index);
+		STREM_COUNT(hs, probes, 1);
+
+		if(hs_key->type != STREM_HS_TAKEN && free == STREM_SIZE_MAX) {
+			free = index;
+		}
+		if(hs_key->type == STREM_HS_EMPTY) {
+			*at_index = free;
 			return NULL;
 		}
+		if(hs_key->type == STREM_HS_TAKEN && keys_equal(hs, hs_key, key, hash)) {
+			return hs_key;
+		}
+		index = probe_index(hs, index, probe, 1);
 	}
+}
 
-	const size_t hash = hs->func(key);
-	size_t key_index = hash % hs->cap;
-	StremHSKey* hs_key = get_key(hs, key_index);
+void* StremHashSet_find_or_insert(StremHashSet* hs, void const* key, bool* inserted) {
+	return StremHashSet_find_or_insert_hashed(hs, key, hash_key(hs, key), inserted);
+}
 
-	while(hs_key->type == STREM_HS_TAKEN) {
-		key_index = (key_index + GAP) % hs->cap;
-		hs_key = get_key(hs, key_index);
+void* StremHashSet_find_or_insert_hashed(StremHashSet* hs, void const* key, size_t hash, bool* inserted) {
+	if(!prepare_insert(hs)) {
+		return NULL;
+	}
+
+	size_t at_index = 0;
+	unsigned int at_psl = 0;
+	StremHSKey* const found = find_or_locate(hs, key, hash, &at_index, &at_psl);
+	if(found != NULL) {
+		*inserted = false;
+		return found->content;
+	}
+
+	*inserted = true;
+	if(hs->bloom != NULL) {
+		StremBloom_add(StremBloom_block(hs->bloom, hs->bloom_blocks, hash), hash);
 	}
-	
-	memcpy(&hs_key->content, key, hs->key_size);
-	hs_key->type = STREM_HS_TAKEN;
-	hs_key->hash = hash;
 	hs->size++;
 
-	return hs_key->content;
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		KEYBUF(new_key_buf, *hs);
+		StremHSKey* const new_key = (StremHSKey*)new_key_buf;
+
+		new_key->hash = hash;
+		new_key->type = STREM_HS_TAKEN;
+		new_key->psl = at_psl;
+		memcpy(&new_key->content, key, hs->key_size);
+		return place_robin_hood_at(hs, new_key, at_index)->content;
+	}
+
+	if(get_key(hs, at_index)->type == STREM_HS_DEAD) {
+		hs->tombstones--;
+	}
+	return fill_slot(hs, at_index, key, hash)->content;
+}
+
+bool StremHashSet_reserve(StremHashSet* hs, size_t count) {
+	size_t cap = hs->cap;
+	while((float)count > cap * hs->saturation) {
+		cap *= 2;
+	}
+
+	if(!StremHashSet_resize(hs, cap)) {
+		return false;
+	}
+	if((float)(count + hs->tombstones) > hs->cap * hs->saturation) {
+		StremHashSet_purge(hs);
+	}
+	return true;
+}
+
+// Tuples from begin to end are placed by one thread, only to slots before slot_end
+typedef struct {
+	StremHashSet* hs;
+	char* tuples;
+	size_t begin;
+	size_t end;
+	size_t slot_end;
+	size_t deferred_end; /* tuples from begin to it met slot_end, they're inserted afterwards */
+	size_t dead_reused;
+} BulkRange;
+
+static void* bulk_fill_range(void* arg) {
+	BulkRange* const range = arg;
+	StremHashSet* const hs = range->hs;
+	const size_t tuple_size = TUPLESIZE(*hs);
+	size_t deferred = range->begin;
+
+	for(size_t i = range->begin; i < range->end; i++) {
+		char const* const tuple = range->tuples + tuple_size * i;
+		size_t hash;
+		memcpy(&hash, tuple, sizeof(size_t));
+
+		size_t index = home_index(hs, hash);
+		while(index < range->slot_end && get_key(hs, index)->type == STREM_HS_TAKEN) {
+			index++;
+		}
+		if(index == range->slot_end) {
+			if(deferred != i) {
+				memcpy(range->tuples + tuple_size * deferred, tuple, tuple_size);
+			}
+			deferred++;
+			continue;
+		}
+
+		if(get_key(hs, index)->type == STREM_HS_DEAD) {
+			range->dead_reused++;
+		}
+		if(hs->bloom != NULL) {
+			StremBloom_add_atomic(StremBloom_block(hs->bloom, hs->bloom_blocks, hash), hash);
+		}
+		fill_slot(hs, index, tuple + sizeof(size_t), hash);
+	}
+	range->deferred_end = deferred;
+	return NULL;
+}
+
+static void bulk_insert_tuple(StremHashSet* hs, char const* tuple) {
+	size_t hash;
+	memcpy(&hash, tuple, sizeof(size_t));
+	insert_hashed(hs, tuple + sizeof(size_t), hash);
+}
+
+// Splits sorted tuples between threads by buckets, each places keys of its buckets
+// to their slot range. Keys which would probe past the range are inserted afterwards.
+static void bulk_fill(
+	StremHashSet* hs, char* tuples,
+	size_t const* bucket_ends, size_t bucket_count, size_t bucket_width, size_t threads
+) {
+	BulkRange ranges[MAX_THREADS];
+	pthread_t ids[MAX_THREADS];
+	bool started[MAX_THREADS];
+	const size_t count = bucket_ends[bucket_count - 1];
+
+	for(size_t t = 0; t < threads; t++) {
+		const size_t first = t * bucket_count / threads;
+		const size_t last = (t + 1) * bucket_count / threads;
+		const size_t begin = first != 0 ? bucket_ends[first - 1] : 0;
+		ranges[t] = (BulkRange){
+			hs,
+			tuples,
+			begin,
+			bucket_ends[last - 1],
+			last < bucket_count ? last * bucket_width : hs->cap,
+			begin,
+			0
+		};
+		started[t] = t != 0 && pthread_create(&ids[t], NULL, bulk_fill_range, &ranges[t]) == 0;
+	}
+
+	/* ranges of threads which failed to start are filled by this one */
+	size_t deferred = 0;
+	size_t dead_reused = 0;
+	for(size_t t = 0; t < threads; t++) {
+		if(started[t]) {
+			pthread_join(ids[t], NULL);
+		} else {
+			bulk_fill_range(&ranges[t]);
+		}
+		deferred += ranges[t].deferred_end - ranges[t].begin;
+		dead_reused += ranges[t].dead_reused;
+	}
+	hs->size += count - deferred;
+	hs->tombstones -= dead_reused;
+
+	for(size_t t = 0; t < threads; t++) {
+		for(size_t i = ranges[t].begin; i < ranges[t].deferred_end; i++) {
+			bulk_insert_tuple(hs, tuples + TUPLESIZE(*hs) * i);
+		}
+	}
+}
+
+bool StremHashSet_insert_bulk(StremHashSet* hs, void const* keys, size_t count, size_t threads) {
+	if(!StremHashSet_reserve(hs, hs->size + count)) {
+		return false;
+	}
+	if(count == 0) {
+		return true;
+	}
+
+	const size_t bucket_width = (hs->cap + BULK_BUCKETS - 1) / BULK_BUCKETS;
+	const size_t bucket_count = (hs->cap + bucket_width - 1) / bucket_width;
+	const size_t tuple_size = TUPLESIZE(*hs);
+	char const* const key_bytes = keys;
+	size_t* const hashes = StremAllocator_alloc(hs->allocator, count * sizeof(size_t));
+	char* const tuples = StremAllocator_alloc(hs->allocator, count * tuple_size);
+	size_t* const bucket_ends = StremAllocator_calloc(hs->allocator, bucket_count, sizeof(size_t));
+	if(hashes == NULL || tuples == NULL || bucket_ends == NULL) {
+		StremAllocator_free(hs->allocator, hashes);
+		StremAllocator_free(hs->allocator, tuples);
+		StremAllocator_free(hs->allocator, bucket_ends);
+		return false;
+	}
+
+	/* Hashing in a tight loop, then copying keys to tuples sorted by bucket of home slot
+	 * (counting sort), so slots are written in order and input is read in order */
+	for(size_t i = 0; i < count; i++) {
+		hashes[i] = hash_key(hs, key_bytes + i * hs->key_size);
+		bucket_ends[home_index(hs, hashes[i]) / bucket_width]++;
+	}
+	for(size_t b = 0, begin = 0; b < bucket_count; b++) {
+		const size_t rows_in_bucket = bucket_ends[b];
+		bucket_ends[b] = begin;
+		begin += rows_in_bucket;
+	}
+	for(size_t i = 0; i < count; i++) {
+		char* const tuple = tuples + tuple_size * bucket_ends[home_index(hs, hashes[i]) / bucket_width]++;
+		memcpy(tuple, &hashes[i], sizeof(size_t));
+		memcpy(tuple + sizeof(size_t), key_bytes + i * hs->key_size, hs->key_size);
+	}
+
+	/* without triangular probing free_index returns the first free slot after home one,
+	 * so keys of disjoint slot ranges may be placed in parallel */
+	const bool adjacent = (hs->mode == STREM_HS_LINEAR && hs->probe_seq == STREM_SEQ_LINEAR)
+		|| (hs->mode == STREM_HS_GROUP && hs->probe_seq != STREM_SEQ_TRIANGULAR);
+	const size_t max_threads = count / BULK_THREAD_ROWS;
+	threads = threads < max_threads ? threads : max_threads;
+	threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+	if(threads > 1 && adjacent) {
+		bulk_fill(hs, tuples, bucket_ends, bucket_count, bucket_width, threads);
+	} else {
+		for(size_t i = 0; i < count; i++) {
+			bulk_insert_tuple(hs, tuples + tuple_size * i);
+		}
+	}
+
+	StremAllocator_free(hs->allocator, hashes);
+	StremAllocator_free(hs->allocator, tuples);
+	StremAllocator_free(hs->allocator, bucket_ends);
+	return true;
+}
+
+// Type of slot claimed by insert_concurrent until its key is written.
+// Low bits tell it from other types, the rest are hash bits.
+#define BUSY_TYPE(hash) ((unsigned)((hash) >> 32) << 2 | 3u)
+
+void* StremHashSet_insert_concurrent(StremHashSet* hs, void const* key, bool* inserted) {
+	assert(hs->mode == STREM_HS_LINEAR && "Concurrent insert probes single slots");
+	const size_t hash = hash_key(hs, key);
+	const unsigned busy = BUSY_TYPE(hash);
+	size_t index = home_index(hs, hash);
+
+	if(hs->bloom != NULL) {
+		StremBloom_add_atomic(StremBloom_block(hs->bloom, hs->bloom_blocks, hash), hash);
+	}
+
+	for(size_t probe = 1; probe <= hs->cap; probe++) {
+		StremHSKey* const hs_key = get_key(hs, index);
+		unsigned type = __atomic_load_n((unsigned*)&hs_key->type, __ATOMIC_ACQUIRE);
+
+		if(type == STREM_HS_EMPTY) {
+			if(__atomic_compare_exchange_n(
+				(unsigned*)&hs_key->type, &type, busy, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE
+			)) {
+				hs_key->hash = hash;
+				memcpy(&hs_key->content, key, hs->key_size);
+				__atomic_store_n((unsigned*)&hs_key->type, STREM_HS_TAKEN, __ATOMIC_RELEASE);
+				__atomic_fetch_add(&hs->size, 1, __ATOMIC_RELAXED);
+				*inserted = true;
+				return hs_key->content;
+			}
+			/* lost the slot, type now holds the winner's one */
+		}
+		if(type == busy) {
+			/* may be the same key, waiting until it's written */
+			do {
+				type = __atomic_load_n((unsigned*)&hs_key->type, __ATOMIC_ACQUIRE);
+			} while(type == busy);
+		}
+		if(type == STREM_HS_TAKEN
+			&& hs_key->hash == hash
+			&& cmp_keys(hs, hs_key->content, key)
+		) {
+			*inserted = false;
+			return hs_key->content;
+		}
+
+		index = probe_index(hs, index, probe, 1);
+	}
+	return NULL;
+}
+
+static StremHSKey* key_at(StremHashSet* hs, void const* key) {
+	return key_at_hashed(hs, key, hash_key(hs, key));
+}
+
+static void prefetch_home(StremHashSet* hs, size_t hash) {
+	const size_t index = home_index(hs, hash);
+
+	if(hs->bloom != NULL) {
+		__builtin_prefetch(StremBloom_block(hs->bloom, hs->bloom_blocks, hash));
+	}
+	if(hs->mode == STREM_HS_GROUP) {
+		__builtin_prefetch(hs->ctrl + index);
+	}
+	__builtin_prefetch(get_key(hs, index));
+}
+
+void StremHashSet_at_batch(
+	StremHashSet* hs, void const* keys, size_t count, void** keys_out
+) {
+	size_t hashes[BATCH_CHUNK];
+	char const* chunk = keys;
+
+	for(size_t done = 0; done < count; done += BATCH_CHUNK) {
+		const size_t chunk_size = count - done < BATCH_CHUNK ? count - done : BATCH_CHUNK;
+
+		for(size_t i = 0; i < chunk_size; i++) {
+			hashes[i] = hash_key(hs, chunk + i*hs->key_size);
+		}
+		StremHashSet_at_batch_hashed(hs, chunk, hashes, chunk_size, keys_out + done);
+		chunk += chunk_size*hs->key_size;
+	}
+}
+
+void StremHashSet_at_batch_hashed(
+	StremHashSet* hs, void const* keys, size_t const* hashes, size_t count, void** keys_out
+) {
+	char const* chunk = keys;
+
+	/* Prefetching the whole chunk first, so cache misses of its home slots overlap */
+	for(size_t done = 0; done < count; done += BATCH_CHUNK) {
+		const size_t chunk_size = count - done < BATCH_CHUNK ? count - done : BATCH_CHUNK;
+
+		for(size_t i = 0; i < chunk_size; i++) {
+			prefetch_home(hs, hashes[done + i]);
+		}
+		for(size_t i = 0; i < chunk_size; i++) {
+			StremHSKey* const hs_key = key_at_hashed(hs, chunk + i*hs->key_size, hashes[done + i]);
+			keys_out[done + i] = hs_key != NULL ? hs_key->content : NULL;
+		}
+
+		chunk += chunk_size*hs->key_size;
+	}
 }
 
 void* StremHashSet_at(StremHashSet* hs, void const* key) {
@@ -250,8 +1079,265 @@ void* StremHashSet_remove(StremHashSet* hs, void const* key) {
 		return NULL;
 	}
 
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		hs->size--;
+		return remove_backward_shift(hs, hs_key)->content;
+	}
+
 	hs_key->type = STREM_HS_DEAD;
+	if(hs->mode == STREM_HS_GROUP) {
+		const size_t index = ((char*)hs_key - (char*)hs->keys) / KEYSIZE(*hs);
+		StremGroup_set(hs->ctrl, hs->cap, index, STREM_CTRL_DEAD);
+	}
 	hs->size--;
+	hs->tombstones++;
 
 	return hs_key->content;
 }
+
+// Erases matching keys in one pass over slots. Every kept key is shifted back over
+// erased ones as far as its home slot allows, so no dead slots are left and order holds.
+// Pass starts at empty slot or key on its home slot, no key before it has home after it.
+static size_t erase_robin_hood(StremHashSet* hs, StremKeyPredicate pred, void* ctx) {
+	const size_t cap = hs->cap;
+	const size_t key_size = KEYSIZE(*hs);
+	size_t start = 0;
+	size_t erased = 0;
+	size_t write = 0; /* offset from start, kept keys are placed before it */
+
+	while(get_key(hs, start)->type == STREM_HS_TAKEN && get_key(hs, start)->psl != 0) {
+		start++;
+	}
+
+	for(size_t offset = 0; offset < cap; offset++) {
+		StremHSKey* const hs_key = get_key(hs, start + offset < cap ? start + offset : start + offset - cap);
+		if(hs_key->type != STREM_HS_TAKEN) {
+			continue;
+		}
+
+		if(pred(hs_key->content, ctx)) {
+			hs_key->type = STREM_HS_EMPTY;
+			erased++;
+			continue;
+		}
+
+		/* slots from write to offset are empty by now */
+		const size_t home = offset - hs_key->psl;
+		const size_t target = write > home ? write : home;
+		if(target != offset) {
+			StremHSKey* const moved = get_key(hs, start + target < cap ? start + target : start + target - cap);
+			memcpy(moved, hs_key, key_size);
+			moved->psl = (unsigned int)(target - home);
+			hs_key->type = STREM_HS_EMPTY;
+		}
+		write = target + 1;
+	}
+	return erased;
+}
+
+size_t StremHashSet_erase_if(StremHashSet* hs, StremKeyPredicate pred, void* ctx) {
+	assert(hs->grow_mode != (int)GROW_VIEW && "Snapshot view can't be modified");
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		const size_t erased = erase_robin_hood(hs, pred, ctx);
+		hs->size -= erased;
+		return erased;
+	}
+
+	size_t erased = 0;
+	for(size_t i = 0; i < hs->cap; i++) {
+		StremHSKey* const hs_key = get_key(hs, i);
+		if(hs_key->type == STREM_HS_TAKEN && pred(hs_key->content, ctx)) {
+			hs_key->type = STREM_HS_DEAD;
+			if(hs->mode == STREM_HS_GROUP) {
+				StremGroup_set(hs->ctrl, hs->cap, i, STREM_CTRL_DEAD);
+			}
+			erased++;
+		}
+	}
+	hs->size -= erased;
+	hs->tombstones += erased;
+
+	/* misses would probe more dead slots than live ones */
+	if(hs->tombstones > hs->size) {
+		rehash_in_place(hs);
+	}
+	return erased;
+}
+
+// Slots of iter from begin to end are walked by one thread
+typedef struct {
+	StremHashSet* iter;
+	StremHashSet* probe;
+	size_t begin;
+	size_t end;
+	bool keep_found; /* keep keys found in probe, otherwise keep the rest */
+	StremHashSet* dst; /* keys are inserted to dst, or pushed to kept if it's NULL */
+	StremVector /* StremHSKey* */ kept;
+	bool ok;
+} FilterRange;
+
+// Keys of a chunk are probed after all their home slots are prefetched
+static void filter_range(FilterRange* range) {
+	StremHashSet* const iter = range->iter;
+	StremHashSet* const probe = range->probe;
+	StremHSKey* chunk[BATCH_CHUNK];
+	size_t chunk_size = 0;
+
+	range->ok = true;
+	for(size_t i = range->begin; i < range->end || chunk_size != 0;) {
+		for(; i < range->end && chunk_size < BATCH_CHUNK; i++) {
+			StremHSKey* const key = get_key(iter, i);
+			if(key->type == STREM_HS_TAKEN) {
+				prefetch_home(probe, key->hash);
+				chunk[chunk_size++] = key;
+			}
+		}
+
+		for(size_t j = 0; j < chunk_size; j++) {
+			StremHSKey* const key = chunk[j];
+			if((key_at_hashed(probe, key->content, key->hash) != NULL) != range->keep_found) {
+				continue;
+			}
+			if(range->dst != NULL
+				? insert_hashed(range->dst, key->content, key->hash) == NULL
+				: StremVector_push(&range->kept, &key, 1) == NULL
+			) {
+				range->ok = false;
+				return;
+			}
+		}
+		chunk_size = 0;
+	}
+}
+
+static void* filter_thread(void* range) {
+	filter_range(range);
+	return NULL;
+}
+
+// Inserts keys of iter found (or not found) in probe to dst.
+// With threads > 1 slot array of iter is split between them,
+// each collects its keys, which are inserted after all threads finish.
+static bool filter(
+	StremHashSet* dst, StremHashSet* iter, StremHashSet* probe, bool keep_found, size_t threads
+) {
+	if(threads <= 1 || iter->cap < threads * BATCH_CHUNK) {
+		FilterRange range = { iter, probe, 0, iter->cap, keep_found, dst, { 0 }, true };
+		filter_range(&range);
+		return range.ok;
+	}
+	threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+
+	FilterRange ranges[MAX_THREADS];
+	pthread_t ids[MAX_THREADS];
+	bool started[MAX_THREADS];
+	const size_t slots_per_thread = (iter->cap + threads - 1) / threads;
+
+	for(size_t t = 0; t < threads; t++) {
+		const size_t begin = t * slots_per_thread;
+		ranges[t] = (FilterRange){
+			iter,
+			probe,
+			begin,
+			begin + slots_per_thread < iter->cap ? begin + slots_per_thread : iter->cap,
+			keep_found,
+			NULL,
+			StremVector_construct(sizeof(StremHSKey*), BATCH_CHUNK),
+			true
+		};
+		started[t] = ranges[t].kept.content != NULL
+			&& pthread_create(&ids[t], NULL, filter_thread, &ranges[t]) == 0;
+	}
+
+	bool ok = true;
+	for(size_t t = 0; t < threads; t++) {
+		if(started[t]) {
+			pthread_join(ids[t], NULL);
+		} else if(ranges[t].kept.content != NULL) {
+			filter_range(&ranges[t]);
+		} else {
+			ranges[t].ok = false;
+		}
+		ok = ok && ranges[t].ok;
+	}
+
+	for(size_t t = 0; t < threads; t++) {
+		for(size_t i = 0; ok && i < ranges[t].kept.size; i++) {
+			StremHSKey* const key = StremVectorAt(ranges[t].kept, StremHSKey*, i);
+			ok = insert_hashed(dst, key->content, key->hash) != NULL;
+		}
+		StremVector_free(&ranges[t].kept);
+	}
+	return ok;
+}
+
+bool StremHashSet_intersect(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads) {
+	StremHashSet* const smaller = a->size <= b->size ? a : b;
+	StremHashSet* const larger = a->size <= b->size ? b : a;
+
+	return StremHashSet_reserve(dst, smaller->size) && filter(dst, smaller, larger, true, threads);
+}
+
+bool StremHashSet_union(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads) {
+	StremHashSet* const smaller = a->size <= b->size ? a : b;
+	StremHashSet* const larger = a->size <= b->size ? b : a;
+
+	if(!StremHashSet_reserve(dst, a->size + b->size)) {
+		return false;
+	}
+	for(size_t i = 0; i < larger->cap; i++) {
+		StremHSKey* const key = get_key(larger, i);
+		if(key->type == STREM_HS_TAKEN && insert_hashed(dst, key->content, key->hash) == NULL) {
+			return false;
+		}
+	}
+	return filter(dst, smaller, larger, false, threads);
+}
+
+bool StremHashSet_difference(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads) {
+	return StremHashSet_reserve(dst, a->size) && filter(dst, a, b, false, threads);
+}
+
+// Number of probes from home slot (group) of key to index, cap if index isn't on its sequence
+static size_t probe_length(StremHashSet* hs, StremHSKey* hs_key, size_t index) {
+	if(hs->mode == STREM_HS_ROBIN_HOOD) {
+		return hs_key->psl;
+	}
+
+	const size_t stride = hs->mode == STREM_HS_GROUP ? STREM_GROUP_WIDTH : 1;
+	size_t at = home_index(hs, hs_key->hash);
+
+	for(size_t probe = 0; probe < hs->cap; probe++) {
+		const size_t offset = index >= at ? index - at : index + hs->cap - at;
+		if(offset < stride) {
+			return probe;
+		}
+		at = probe_index(hs, at, probe + 1, stride);
+	}
+	return hs->cap;
+}
+
+StremHashStats StremHashSet_stats(StremHashSet* hs) {
+	StremHashStats stats = { 0 };
+
+	for(size_t i = 0; i < hs->cap; i++) {
+		StremHSKey* const hs_key = get_key(hs, i);
+		if(hs_key->type == STREM_HS_TAKEN) {
+			StremHashStats_add_probe(&stats, probe_length(hs, hs_key, i));
+		} else if(hs_key->type == STREM_HS_DEAD) {
+			stats.tombstones++;
+		}
+	}
+
+	stats.size = hs->size;
+	stats.cap = hs->cap;
+	if(stats.size != 0) {
+		stats.avg_probe /= (double)stats.size;
+	}
+	stats.resizes = hs->resizes;
+	stats.key_bytes = hs->cap * KEYSIZE(*hs)
+		+ (hs->ctrl != NULL ? hs->cap + STREM_GROUP_WIDTH - 1 : 0)
+		+ hs->bloom_blocks * sizeof(StremBloomBlock);
+	stats.counters = hs->counters;
+	return stats;
+}
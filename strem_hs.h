@@ -1,9 +1,14 @@
 #ifndef STREM_HS_H_
 #define STREM_HS_H_
+#include <stdint.h>
 #include "strem_vector.h"
-
-typedef size_t(*StremHashFunction)(void const*);
-typedef bool(*StremCmpFunction)(void const*, void const*);
+#include "strem_index.h"
+#include "strem_snapshot.h"
+#include "strem_bloom.h"
+#include "strem_stats.h"
+#include "strem_hash.h"
+// Tells if key is to be erased: (key, ctx)
+typedef bool(*StremKeyPredicate)(void const*, void*);
 
 typedef struct {
 	size_t hash;
@@ -12,28 +17,82 @@ typedef struct {
 		STREM_HS_TAKEN,
 		STREM_HS_DEAD,
 	} type;
+	unsigned int psl; /* STREM_HS_ROBIN_HOOD only: distance from home slot */
 	char content[];
 } StremHSKey;
 
+typedef enum {
+	// Probes slots GAP apart, checking type of every visited key
+	STREM_HS_LINEAR = 0,
+	// Probes STREM_GROUP_WIDTH control bytes at once (SSE2 if available),
+	// visiting keys only if their 7-bit hash tag matches
+	STREM_HS_GROUP,
+	// Probes adjacent slots, keeping keys ordered by distance from home slot.
+	// Remove shifts the chain back instead of leaving STREM_HS_DEAD slots.
+	STREM_HS_ROBIN_HOOD,
+} StremHSMode;
+
 typedef struct {
 	/* private: */
 	void* /* StremHSKey + TKey */ keys;
+	uint8_t* ctrl; /* STREM_HS_GROUP only */
 	StremHashFunction func;
 	StremCmpFunction cmp_func;
 	size_t cap;
 	size_t size;
+	size_t tombstones; /* STREM_HS_DEAD slots, they count towards saturation */
 	size_t key_size;
 	/* public: */
 	float saturation;
 	/* private: */
 	int grow_mode;
+	int mode;
+	int index_policy;
+	int probe_seq; /* ignored by STREM_HS_ROBIN_HOOD, which always probes adjacent slots */
+	StremBloomBlock* bloom; /* NULL unless enabled */
+	size_t bloom_blocks;
+	StremAllocator const* allocator; /* NULL for malloc */
+	size_t resizes;
+	StremHashCounters counters; /* STREM_HASH_COUNTERS only */
 } StremHashSet;
 
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h)
 // If fails to allocate, set.keys == NULL
 StremHashSet StremHashSet_construct(
 	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func
 );
 
+// If fails to allocate, set.keys == NULL
+// Emplaced sets are always STREM_HS_LINEAR
+StremHashSet StremHashSet_construct_mode(
+	size_t key_size, StremHashFunction func, StremCmpFunction cmp_func, StremHSMode mode
+);
+
+// Capacity starts at a power of two and is doubled on growth,
+// so any index policy and probe sequence may be used.
+// Must: probe_seq != STREM_SEQ_TRIANGULAR or index_policy == STREM_INDEX_MASK
+// If fails to allocate, set.keys == NULL
+StremHashSet StremHashSet_construct_policy(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHSMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq
+);
+
+// Same, keys and control bytes are allocated from allocator (NULL for malloc)
+StremHashSet StremHashSet_construct_with(
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHSMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq,
+	StremAllocator const* allocator
+);
+
+// Emplaced sets use STREM_INDEX_MODULO and STREM_SEQ_GAP
 // Must: at_buf_size / key_size > 0
 StremHashSet StremHashSet_emplace(
 	void* at_buf,
@@ -46,20 +105,110 @@ StremHashSet StremHashSet_emplace(
 
 void StremHashSet_free(StremHashSet* ht);
 
+// Builds blocked Bloom filter of keys, which then answers most lookups of absent keys
+// by a single cache line. Insert adds keys to it, remove leaves them,
+// resize rebuilds it from keys left (and drops it if fails to allocate).
+// Returns false and leaves set unfiltered if fails to allocate.
+bool StremHashSet_enable_bloom(StremHashSet* hs);
+
+// Writes set to file in snapshot format, hash_seed is stored to be checked by view.
+// Returns false on write error.
+bool StremHashSet_snapshot_write(StremHashSet* hs, FILE* file, uint64_t hash_seed);
+
+// Set looking keys up right in snapshot buf (e.g. mapped file), nothing is copied or rehashed.
+// Must: buf is aligned to STREM_SNAPSHOT_ALIGN and outlives the set;
+// only at and at_batch are called, free releases nothing.
+// If buf isn't a snapshot of key_size keys written with hash_seed, set.keys == NULL
+StremHashSet StremHashSet_snapshot_view(
+	void const* buf,
+	size_t buf_size,
+	uint64_t hash_seed,
+	size_t key_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+);
+
 // Inserts and returns pointer to key inside table
 // Returns NULL if malloced and need to but can't reallocate
 void* StremHashSet_insert(StremHashSet* ht, void const* const key);
 
+// Returns pointer to key inside set equal to key, inserting key if there's none.
+// Sets *inserted accordingly. Probes set once.
+// Returns NULL if needs and fails to grow.
+void* StremHashSet_find_or_insert(StremHashSet* hs, void const* key, bool* inserted);
+// Same with hash computed by caller.
+// Must: hash is what func of set (or built-in kernel) returns for key
+void* StremHashSet_find_or_insert_hashed(StremHashSet* hs, void const* key, size_t hash, bool* inserted);
+
+// Grows set, so that count keys in total fit without growing.
+// Returns false if can't resize.
+bool StremHashSet_reserve(StremHashSet* hs, size_t count);
+
+// Inserts count keys stored contiguously, reserving room once.
+// Keys are hashed in one pass and sorted by home slot, so slots are written in order.
+// With threads > 1 (and probing other than robin hood or triangular),
+// threads place keys of disjoint slot ranges in parallel.
+// Must: keys are distinct and absent from set, as for insert.
+// Returns false and inserts nothing if fails to allocate.
+bool StremHashSet_insert_bulk(StremHashSet* hs, void const* keys, size_t count, size_t threads);
+
+// Inserts key unless it's already in set, may be called by many threads at once.
+// Claims slots by CAS on their type, which holds hash bits while the key is written,
+// so colliding threads wait only for keys with matching bits.
+// Never resizes: set must be sized for all keys beforehand (e.g. emplaced).
+// Must: STREM_HS_LINEAR; only insert_concurrent is called until all threads finish.
+// Sets *inserted to true if key is new. Returns pointer to key inside set,
+// NULL if probed every slot and found no room.
+void* StremHashSet_insert_concurrent(StremHashSet* hs, void const* key, bool* inserted);
+
 // Removes the pair and returns ptr to just removed key (NULL if no key found).
 // key pointer is valid until any action with the table.
 void* StremHashSet_remove(StremHashSet* ht, void const* key);
 
+// Erases every key for which pred(key, ctx) is true in one pass over slots.
+// Robin hood sets shift kept keys back in the same pass, others leave dead slots,
+// purged in place if they outnumber live keys. Bloom filter keeps erased keys.
+// Must: set isn't a snapshot view; pred doesn't modify set.
+// Returns number of keys erased.
+size_t StremHashSet_erase_if(StremHashSet* hs, StremKeyPredicate pred, void* ctx);
+
 // Returns pointer to associated value (NULL if no key found)
 void* StremHashSet_at(StremHashSet* ht, void const* key);
 
+// Looks up count keys stored contiguously, writing pointer to key inside set
+// (NULL if no key found) for each of them to keys_out.
+// Hashes and prefetches home slots of a chunk of keys before probing any of them.
+void StremHashSet_at_batch(
+	StremHashSet* hs, void const* keys, size_t count, void** keys_out
+);
+// Same with hashes of keys computed by caller, must be as for find_or_insert_hashed
+void StremHashSet_at_batch_hashed(
+	StremHashSet* hs, void const* keys, size_t const* hashes, size_t count, void** keys_out
+);
+
+// Bulk set algebra, keys are inserted to dst, which is grown beforehand to fit them.
+// The smaller set (a for difference) is walked slot by slot,
+// its keys are probed in the other set in prefetched batches, stored hashes are reused.
+// With threads > 1 slots are split between threads probing in parallel,
+// keys are inserted to dst after they finish.
+// Must: all sets have the same key_size, func and cmp_func; dst is empty and is neither a nor b.
+// Returns false if fails to allocate, dst holds some of keys then.
+bool StremHashSet_intersect(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads);
+bool StremHashSet_union(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads);
+// Keys of a absent from b
+bool StremHashSet_difference(StremHashSet* dst, StremHashSet* a, StremHashSet* b, size_t threads);
+
+// Walks all slots, so costs as much as a resize without allocating.
+// Counters are reported as they are, they're never reset.
+StremHashStats StremHashSet_stats(StremHashSet* hs);
+
 // Resizes and rehashes key vector
 // Returns false and doesn't rehash, if can't resize;
 // Otherwise. returns true.
 bool StremHashSet_resize(StremHashSet* ht, size_t newcap);
 
+// Rehashes keys in place at the same capacity, turning STREM_HS_DEAD slots empty.
+// Allocates nothing. Insert calls it instead of growing when most of saturation is dead slots.
+void StremHashSet_purge(StremHashSet* hs);
+
 #endif // STREM_HS_H_
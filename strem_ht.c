@@ -1,119 +1,373 @@
 #include "strem_ht.h"
+#include "strem_group.h"
+#include "strem_index.h"
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
+#include <pthread.h>
 
+#ifdef STREM_HT_COMPACT
+#define KEYSIZE(ht) pow2_ceil(sizeof(StremHTKey) + (ht).key_size)
+#define FINGERPRINT(hash) ((uint16_t)((hash) >> (sizeof(size_t) * 8 - 16)))
+#else
 #define KEYSIZE(ht) (sizeof(StremHTKey) + (ht).key_size)
+#define FINGERPRINT(hash) (hash)
+#endif
+// value slot must fit free chain node and keep next slots aligned
+#define VALUESIZE(ht) (((ht).value_size < sizeof(StremSegrLine_FreeNode) \
+	? sizeof(StremSegrLine_FreeNode) \
+	: (ht).value_size + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*))
+// size_t-aligned VLA big enough for one key of ht
+#define KEYBUF(name, ht) size_t name[(KEYSIZE(ht) + sizeof(size_t) - 1) / sizeof(size_t)]
+
+// Pair copied by insert_bulk: hash, key, value
+#define TUPLESIZE(ht) ((sizeof(size_t) + (ht).key_size + (ht).value_size + sizeof(size_t) - 1) \
+	/ sizeof(size_t) * sizeof(size_t))
+
+#define PROBING(ht) ((ht).mode & ~STREM_HT_INCREMENTAL)
+#define MIGRATING(ht) ((ht).old_keys.content != NULL)
 
 #define DEFAULT_HT_CAP 32
 #define DEFAULT_HT_SATURATION 0.6f
-#define GAP 5
-// number of keys in collision chain including the tail one, which may not collide
-#define COLLISION_MAX_LENGTH 5
+// old slots moved by every operation during incremental resize,
+// must finish the move before keys grow from saturation/2 to saturation
+#define MIGRATE_STEP 16
+// keys hashed and prefetched ahead of probing by at_batch
+#define BATCH_CHUNK 32
+// buckets of home slots insert_bulk sorts keys into, at most;
+// few enough for scattering to keep its write targets in cache
+#define BULK_BUCKETS ((size_t)1 << 12)
+// keys placed by one thread of insert_bulk are never fewer
+#define BULK_THREAD_ROWS 4096
+// threads started by insert_bulk, at most
+#define MAX_THREADS 64
+
+#ifdef STREM_HT_COMPACT
+// Must: size > 1
+static size_t pow2_ceil(size_t size) {
+	return (size_t)1 << (sizeof(unsigned long long) * 8 - __builtin_clzll((unsigned long long)size - 1));
+}
+
+// The first value block holds DEFAULT_HT_CAP slots, every next one as many as all previous
+static size_t value_block_base(size_t block) {
+	return block == 0 ? 0 : (size_t)DEFAULT_HT_CAP << (block - 1);
+}
+
+static char* value_at_index(StremHashTable* ht, size_t index) {
+	const size_t block = index < DEFAULT_HT_CAP ? 0
+		: sizeof(unsigned long long) * 8 - (size_t)__builtin_clzll(index / DEFAULT_HT_CAP);
+	char* const begin = StremVectorAt(ht->value_blocks, char*, block);
+	return begin + (index - value_block_base(block)) * VALUESIZE(*ht);
+}
+
+// Looks for block of value_ptr from the last, biggest one
+static uint32_t index_of_value(StremHashTable* ht, char const* value_ptr) {
+	const uintptr_t at = (uintptr_t)value_ptr;
+
+	for(size_t block = ht->value_blocks.size; block-- > 0;) {
+		const uintptr_t begin = (uintptr_t)StremVectorAt(ht->value_blocks, char*, block);
+		const size_t block_cap = block == 0 ? DEFAULT_HT_CAP : value_block_base(block);
+		if(at >= begin && at < begin + block_cap * VALUESIZE(*ht)) {
+			return (uint32_t)(value_block_base(block) + (at - begin) / VALUESIZE(*ht));
+		}
+	}
+	assert(false && "Value is not in any value block");
+	return 0;
+}
+#endif
 
 static StremHTKey* get_key(StremHashTable* ht, size_t index) {
 	return (StremHTKey*)((char*)ht->keys.content + KEYSIZE(*ht) * index);
 }
 
-// returns length of collision chain including the tail one which may not collide 
-// returns 0 if any other key in chain is on its needed place
-static size_t get_collision_chain(
-	StremHashTable* ht, 
-	StremHTKey* start_key, 
-	StremHTKey* col_stack[COLLISION_MAX_LENGTH]
-) {
+static size_t home_index(StremHashTable* ht, size_t hash) {
+	return StremIndex_home(hash, ht->keys.capacity_elems, ht->index_policy);
+}
+
+// stride is 1 for slots, STREM_GROUP_WIDTH for groups
+static size_t probe_index(StremHashTable* ht, size_t index, size_t probe, size_t stride) {
+	return StremIndex_next(
+		index, probe, ht->keys.capacity_elems, ht->index_policy, ht->probe_seq, stride
+	);
+}
+
+// Value of taken slot, not for snapshot view
+static char* slot_value(StremHashTable* ht, StremHTKey* ht_key) {
+#ifdef STREM_HT_COMPACT
+	return value_at_index(ht, ht_key->value_index);
+#else
+	(void)ht;
+	return ht_key->value_ptr;
+#endif
+}
+
+static void set_slot_value(StremHashTable* ht, StremHTKey* ht_key, char* value_ptr) {
+#ifdef STREM_HT_COMPACT
+	ht_key->value_index = value_ptr != NULL ? index_of_value(ht, value_ptr) : 0;
+#else
+	(void)ht;
+	ht_key->value_ptr = value_ptr;
+#endif
+}
+
+// Built-in hash of key_size bytes if there's no func for them
+static size_t hash_key(StremHashTable* ht, void const* key) {
+	return ht->func != NULL ? ht->func(key) : StremHash_bytes(key, ht->key_size);
+}
+
+// Full hash of taken slot, compact one keeps just a fingerprint, so key is rehashed
+static size_t slot_hash(StremHashTable* ht, StremHTKey* ht_key) {
+#ifdef STREM_HT_COMPACT
+	return hash_key(ht, ht_key->content);
+#else
+	(void)ht;
+	return ht_key->hash;
+#endif
+}
+
+// Compares stored hash (fingerprint) first, cmp_func is called only if they match
+static bool keys_equal(StremHashTable* ht, StremHTKey* ht_key, void const* key, size_t hash) {
+	if(FINGERPRINT(hash) != ht_key->hash) {
+		return false;
+	}
+	STREM_COUNT(ht, cmp_calls, 1);
+	return ht->cmp_func != NULL
+		? ht->cmp_func(ht_key->content, key)
+		: memcmp(ht_key->content, key, ht->key_size) == 0;
+}
+
+static uint8_t* ctrl_construct(StremAllocator const* allocator, size_t cap) {
+	uint8_t* const ctrl = StremAllocator_alloc(allocator, cap + STREM_GROUP_WIDTH - 1);
+	if(ctrl != NULL) {
+		memset(ctrl, STREM_CTRL_EMPTY, cap + STREM_GROUP_WIDTH - 1);
+	}
+	return ctrl;
+}
+
+// Returns index of the first empty or dead slot in hash's probe sequence
+static size_t free_index(StremHashTable* ht, size_t hash) {
 	const size_t keys_cap = ht->keys.capacity_elems;
-	size_t col_len = 0;
-	StremHTKey* key = start_key;
-	StremHTKey* new_key = get_key(ht, key->hash % keys_cap);
+	size_t index = home_index(ht, hash);
 
-	for(;new_key->type == STREM_HT_TAKEN && col_len < COLLISION_MAX_LENGTH - 1; col_len++) {
-		if(key == new_key) {
-			return 0;
+	if(PROBING(*ht) == STREM_HT_GROUP) {
+		for(size_t probe = 1;; probe++) {
+			const StremGroupMask free = StremGroup_match_free(ht->ctrl + index);
+			if(free != 0) {
+				index += StremGroupMask_next(free);
+				return index < keys_cap ? index : index - keys_cap;
+			}
+			index = probe_index(ht, index, probe, STREM_GROUP_WIDTH);
 		}
-		col_stack[col_len] = key;
-		col_stack[col_len + 1] = new_key;
-		key = new_key;
-		new_key = get_key(ht, key->hash % keys_cap);
 	}
 
-	return col_len + 1; // + 1 is the last added new_key which may not collide 
+	for(size_t probe = 1; get_key(ht, index)->type == STREM_HT_TAKEN; probe++) {
+		index = probe_index(ht, index, probe, 1);
+	}
+	return index;
 }
 
-// collision chain consists of pointers to keys including the tail one which may not collide
-// function shifts the chain, copying each key to the location of next key
-static void resolve_collision_chain(
-	StremHTKey* col_stack[COLLISION_MAX_LENGTH],
-	size_t key_size_with_content,
-	size_t col_len
-) {
-	if(col_len < 2) {
-		return;
-	}
-	for(col_len -= 2; col_len != 0; col_len--) {
-		memcpy(col_stack[col_len + 1], col_stack[col_len], key_size_with_content);
+static void take_slot(StremHashTable* ht, size_t index, size_t hash) {
+	if(PROBING(*ht) == STREM_HT_GROUP) {
+		StremGroup_set(ht->ctrl, ht->keys.capacity_elems, index, StremGroup_tag(hash));
 	}
-	col_stack[0]->type = STREM_HT_EMPTY;
 }
 
-void StremHashTable_resize(StremHashTable* ht, size_t newcap) {
-	const size_t oldcap = ht->keys.capacity_elems;
-	if(newcap <= oldcap) {
-		return;
+static size_t next_index(StremHashTable* ht, size_t index) {
+	return index + 1 == ht->keys.capacity_elems ? 0 : index + 1;
+}
+
+#ifdef STREM_HT_COMPACT
+// Compact slot saturates psl at STREM_HT_MAX_PSL instead of wrapping,
+// saturated one is recomputed as distance of index from home slot of key
+static unsigned int slot_psl(StremHashTable* ht, StremHTKey* ht_key, size_t index) {
+	if(ht_key->psl < STREM_HT_MAX_PSL) {
+		return ht_key->psl;
 	}
-	StremVector_reserve(&ht->keys, newcap);
+	const size_t home = home_index(ht, slot_hash(ht, ht_key));
+	return (unsigned int)(index >= home ? index - home : index + ht->keys.capacity_elems - home);
+}
+
+static void set_psl(StremHTKey* ht_key, unsigned int psl) {
+	ht_key->psl = psl < STREM_HT_MAX_PSL ? psl : STREM_HT_MAX_PSL;
+}
+#else
+static unsigned int slot_psl(StremHashTable* ht, StremHTKey* ht_key, size_t index) {
+	(void)ht;
+	(void)index;
+	return ht_key->psl;
+}
 
+static void set_psl(StremHTKey* ht_key, unsigned int psl) {
+	ht_key->psl = psl;
+}
+#endif
+
+// Tells if key in slot index is closer to its home than psl.
+// Stored psl is never above the real one, so it's recomputed only if saturated and below.
+static bool psl_below(StremHashTable* ht, StremHTKey* ht_key, size_t index, unsigned int psl) {
+	return ht_key->psl < psl && slot_psl(ht, ht_key, index) < psl;
+}
+
+// Continues robin hood insertion from index, which is psl slots from home of key.
+// Every slot before index must be taken by a key with psl not less than key's one.
+// Walking on, key takes place of the first key which is closer to its own home,
+// the displaced key continues the walk.
+// Uses key as a scratch buffer, returns slot where key is placed.
+static StremHTKey* place_robin_hood_at(StremHashTable* ht, StremHTKey* key, size_t index, unsigned int psl) {
 	const size_t key_size = KEYSIZE(*ht);
-	StremHTKey* collision_stack[COLLISION_MAX_LENGTH];
-//	char* const collided_key_buf = malloc(sizeof(char)*key_size);
-	char collided_key_buf[key_size]; // VLA
-	bool key_buf_empty = true;
+	KEYBUF(swap_buf, *ht);
+	StremHTKey* placed = NULL;
 
-	for(size_t i = 0; i < oldcap; i++) {
-		StremHTKey* key = get_key(ht, i);
-		if(key->type != STREM_HT_TAKEN) {
-			continue;
+	while(true) {
+		StremHTKey* const ht_key = get_key(ht, index);
+
+		if(ht_key->type != STREM_HT_TAKEN) {
+			set_psl(key, psl);
+			memcpy(ht_key, key, key_size);
+			return placed != NULL ? placed : ht_key;
+		}
+		if(psl_below(ht, ht_key, index, psl)) {
+			const unsigned int displaced_psl = slot_psl(ht, ht_key, index);
+			set_psl(key, psl);
+			memcpy(swap_buf, ht_key, key_size);
+			memcpy(ht_key, key, key_size);
+			memcpy(key, swap_buf, key_size);
+			psl = displaced_psl;
+			if(placed == NULL) {
+				placed = ht_key;
+			}
 		}
 
-		const size_t new_index = key->hash % newcap;
-		StremHTKey* const new_key = get_key(ht, new_index);
+		index = next_index(ht, index);
+		psl++;
+	}
+}
 
-		if(new_index == i) {
-			continue;
-		} else if(new_key->type != STREM_HT_TAKEN) {
-			memcpy(new_key, key, key_size);
+// Robin hood insertion walking from home slot
+static StremHTKey* place_robin_hood(StremHashTable* ht, StremHTKey* key) {
+	return place_robin_hood_at(ht, key, home_index(ht, slot_hash(ht, key)), 0);
+}
+
+// Copies taken key into table, key may be clobbered. Returns slot where key is placed.
+static StremHTKey* place_key(StremHashTable* ht, StremHTKey* key) {
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		return place_robin_hood(ht, key);
+	}
+
+	const size_t hash = slot_hash(ht, key);
+	const size_t index = free_index(ht, hash);
+	StremHTKey* const ht_key = get_key(ht, index);
+	if(ht_key->type == STREM_HT_DEAD) {
+		ht->tombstones--;
+	}
+	memcpy(ht_key, key, KEYSIZE(*ht));
+	take_slot(ht, index, hash);
+	return ht_key;
+}
+
+// Rehashes keys of current arrays in place, dropping dead slots.
+// Taken keys are marked dead first, then each is moved to the first free slot
+// of its probe sequence, swapping with a key there that isn't placed yet.
+// Slots before a placed key in its sequence are taken by placed keys, so they stay taken.
+static void rehash_in_place(StremHashTable* ht) {
+	const size_t cap = ht->keys.capacity_elems;
+	const size_t key_size = KEYSIZE(*ht);
+	KEYBUF(swap_buf, *ht);
+
+	for(size_t i = 0; i < cap; i++) {
+		StremHTKey* const ht_key = get_key(ht, i);
+		ht_key->type = ht_key->type == STREM_HT_TAKEN ? STREM_HT_DEAD : STREM_HT_EMPTY;
+		if(PROBING(*ht) == STREM_HT_GROUP) {
+			StremGroup_set(ht->ctrl, cap, i, ht_key->type == STREM_HT_DEAD ? STREM_CTRL_DEAD : STREM_CTRL_EMPTY);
+		}
+	}
+
+	for(size_t i = 0; i < cap;) {
+		StremHTKey* const ht_key = get_key(ht, i);
+		if(ht_key->type != STREM_HT_DEAD) {
+			i++;
 			continue;
 		}
 
-		size_t col_len = COLLISION_MAX_LENGTH + 1;
-		StremHTKey* chain_start = key;
+		const size_t hash = slot_hash(ht, ht_key);
+		const size_t index = free_index(ht, hash);
+		StremHTKey* const new_key = get_key(ht, index);
+		if(index == i) {
+			i++;
+		} else if(new_key->type == STREM_HT_EMPTY) {
+			memcpy(new_key, ht_key, key_size);
+			ht_key->type = STREM_HT_EMPTY;
+			if(PROBING(*ht) == STREM_HT_GROUP) {
+				StremGroup_set(ht->ctrl, cap, i, STREM_CTRL_EMPTY);
+			}
+			i++;
+		} else {
+			/* slot i now holds the displaced key, it's placed on the next pass */
+			memcpy(swap_buf, new_key, key_size);
+			memcpy(new_key, ht_key, key_size);
+			memcpy(ht_key, swap_buf, key_size);
+		}
+		new_key->type = STREM_HT_TAKEN;
+		take_slot(ht, index, hash);
+	}
+	ht->tombstones = 0;
+}
 
-		while(col_len >= COLLISION_MAX_LENGTH) {
-			col_len = get_collision_chain(ht, key, collision_stack);
+static void migrate(StremHashTable* ht, size_t slot_count);
 
-			if(col_len == 0) {
-				/* if 0, a key on its dedicated slot is met.
-				 * In this case, we can't rehash keys in chain.
-				 *
-				 * If chain was long enough for 2+ iterations,
-				 * buffed key is placed in the beginning of chain.
-				 */ 
-				if(!key_buf_empty) {
-					memcpy(chain_start, collided_key_buf, key_size);
-				}
-			}
+void StremHashTable_purge(StremHashTable* ht) {
+	if(MIGRATING(*ht)) {
+		migrate(ht, STREM_SIZE_MAX);
+	}
+	/* robin hood tables never leave dead slots */
+	if(ht->value_base == NULL && PROBING(*ht) != STREM_HT_ROBIN_HOOD && ht->tombstones != 0) {
+		rehash_in_place(ht);
+	}
+}
 
-			if(col_len == COLLISION_MAX_LENGTH) {
-				memcpy(collided_key_buf, collision_stack[col_len - 1], key_size);
-				key = (StremHTKey*)collided_key_buf;
-				key_buf_empty = false;
-			}
+void StremHashTable_resize(StremHashTable* ht, size_t newcap) {
+	if(MIGRATING(*ht)) {
+		migrate(ht, STREM_SIZE_MAX);
+	}
+
+	const size_t oldcap = ht->keys.capacity_elems;
+	if(newcap <= oldcap) {
+		return;
+	}
+
+	/* Rehashing into fresh arrays: in-place pass would read
+	 * uninitialized slots of reallocated tail. */
+	StremVector newkeys = StremVector_construct_with(KEYSIZE(*ht), newcap, ht->allocator);
+	uint8_t* newctrl = NULL;
+	if(newkeys.content == NULL) {
+		return;
+	}
+	if(PROBING(*ht) == STREM_HT_GROUP && (newctrl = ctrl_construct(ht->allocator, newcap)) == NULL) {
+		StremVector_free(&newkeys);
+		return;
+	}
+
+	StremVector oldkeys = ht->keys;
+	uint8_t* const oldctrl = ht->ctrl;
+	const size_t key_size = KEYSIZE(*ht);
+
+	newkeys.size = oldkeys.size;
+	ht->keys = newkeys;
+	ht->ctrl = newctrl;
 
-			resolve_collision_chain(collision_stack, KEYSIZE(*ht), col_len);
+	for(size_t i = 0; i < oldcap; i++) {
+		StremHTKey* const key = (StremHTKey*)((char*)oldkeys.content + key_size*i);
+		if(key->type != STREM_HT_TAKEN) {
+			continue;
 		}
-		
+
+		place_key(ht, key);
 	}
-	
-//	free(collided_key_buf);
+
+	StremVector_free(&oldkeys);
+	StremAllocator_free(ht->allocator, oldctrl);
+	ht->tombstones = 0;
+	ht->resizes++;
 }
 
 StremHashTable StremHashTable_construct(
@@ -122,31 +376,312 @@ StremHashTable StremHashTable_construct(
 	StremHashFunction func,
 	StremCmpFunction cmp_func
 ) {
+	return StremHashTable_construct_mode(key_size, value_size, func, cmp_func, STREM_HT_LINEAR);
+}
+
+StremHashTable StremHashTable_construct_mode(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHTMode mode
+) {
+	return StremHashTable_construct_policy(
+		key_size, value_size, func, cmp_func, mode, STREM_INDEX_MODULO, STREM_SEQ_GAP
+	);
+}
+
+StremHashTable StremHashTable_construct_policy(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHTMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq
+) {
+	return StremHashTable_construct_with(
+		key_size, value_size, func, cmp_func, mode, index_policy, probe_seq, NULL
+	);
+}
+
+StremHashTable StremHashTable_construct_with(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremHTMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq,
+	StremAllocator const* allocator
+) {
+	assert((probe_seq != STREM_SEQ_TRIANGULAR || index_policy == STREM_INDEX_MASK)
+		&& "Triangular probing visits every slot only in power-of-two table");
+	assert(StremIndex_is_pow2(DEFAULT_HT_CAP));
 	StremHashTable ht;
 
 	ht.key_size = key_size;
 	ht.value_size = value_size;
 	ht.saturation = DEFAULT_HT_SATURATION;
-	ht.func = func;
-	ht.cmp_func = cmp_func;
-	ht.keys = StremVector_construct(KEYSIZE(ht), DEFAULT_HT_CAP);
-	ht.values = StremVector_construct(ht.value_size, DEFAULT_HT_CAP);
-	ht.dead_values = StremVector_construct(sizeof(void*), DEFAULT_HT_CAP);
+	ht.func = func != NULL ? func : StremHash_for_size(key_size);
+	ht.cmp_func = cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size);
+	ht.mode = (int)mode;
+	ht.index_policy = (int)index_policy;
+	ht.probe_seq = (int)probe_seq;
+	ht.allocator = allocator;
+	ht.keys = StremVector_construct_with(KEYSIZE(ht), DEFAULT_HT_CAP, allocator);
+	ht.ctrl = NULL;
+	ht.tombstones = 0;
+	ht.old_keys = (StremVector){ 0 };
+	ht.old_ctrl = NULL;
+	ht.migrated = 0;
+	ht.value_blocks = StremVector_construct_with(sizeof(char*), DEFAULT_HT_CAP, allocator);
+	ht.free_values = NULL;
+	ht.removed_value = NULL;
+	ht.value_cap = 0;
+	ht.value_base = NULL;
+	ht.resizes = 0;
+	ht.counters = (StremHashCounters){ 0 };
+
+	if(PROBING(ht) == STREM_HT_GROUP && (ht.ctrl = ctrl_construct(allocator, DEFAULT_HT_CAP)) == NULL) {
+		StremVector_free(&ht.keys);
+	}
 	return ht;
 }
 
 void StremHashTable_free(StremHashTable* ht) {
+	if(ht->value_base != NULL) {
+		ht->keys.content = NULL;
+		ht->ctrl = NULL;
+		ht->value_base = NULL;
+		return;
+	}
 	StremVector_free(&ht->keys);
-	StremVector_free(&ht->values);
-	StremVector_free(&ht->dead_values);
+	for(size_t i = 0; i < ht->value_blocks.size; i++) {
+		StremAllocator_free(ht->allocator, StremVectorAt(ht->value_blocks, char*, i));
+	}
+	StremVector_free(&ht->value_blocks);
+	ht->free_values = NULL;
+	ht->removed_value = NULL;
+	ht->value_cap = 0;
+	StremVector_free(&ht->old_keys);
+	StremAllocator_free(ht->allocator, ht->ctrl);
+	StremAllocator_free(ht->allocator, ht->old_ctrl);
+	ht->ctrl = NULL;
+	ht->old_ctrl = NULL;
 }
 
-static StremHTKey* key_at(StremHashTable* ht, void const* key) {
-	const size_t hash = ht->func(key);
+bool StremHashTable_snapshot_write(StremHashTable* ht, FILE* file, uint64_t hash_seed) {
+	/* keys of both generations must be in one array */
+	StremHashTable_resize(ht, 0);
+
+	const size_t cap = ht->keys.capacity_elems;
+	const uint64_t keys_bytes = (uint64_t)cap * KEYSIZE(*ht);
+	const uint64_t ctrl_bytes = PROBING(*ht) == STREM_HT_GROUP ? cap + STREM_GROUP_WIDTH - 1 : 0;
+	StremSnapshotHeader header = { 0 };
+
+	memcpy(header.magic, STREM_SNAPSHOT_HT_MAGIC, sizeof(header.magic));
+	header.version = STREM_SNAPSHOT_VERSION;
+	header.slot_header_size = sizeof(StremHTKey);
+	header.hash_seed = hash_seed;
+	header.key_size = ht->key_size;
+	header.value_size = ht->value_size;
+	header.cap = cap;
+	header.size = ht->keys.size;
+	header.mode = (uint32_t)PROBING(*ht);
+	header.index_policy = (uint32_t)ht->index_policy;
+	header.probe_seq = (uint32_t)ht->probe_seq;
+	header.keys_offset = StremSnapshot_align(sizeof(header));
+	header.ctrl_offset = ctrl_bytes != 0 ? StremSnapshot_align(header.keys_offset + keys_bytes) : 0;
+	header.values_offset = StremSnapshot_align(
+		ctrl_bytes != 0 ? header.ctrl_offset + ctrl_bytes : header.keys_offset + keys_bytes
+	);
+	header.total_size = header.values_offset + (uint64_t)ht->keys.size * VALUESIZE(*ht);
+
+	if(fwrite(&header, sizeof(header), 1, file) != 1
+		|| !StremSnapshot_pad(file, sizeof(header), header.keys_offset)
+	) {
+		return false;
+	}
+
+	/* values are numbered in slot order */
+	KEYBUF(key_buf, *ht);
+	StremHTKey* const key = (StremHTKey*)key_buf;
+	uint64_t value_offset = 0;
+	for(size_t i = 0; i < cap; i++) {
+		memcpy(key, get_key(ht, i), KEYSIZE(*ht));
+		if(key->type == STREM_HT_TAKEN) {
+#ifdef STREM_HT_COMPACT
+			key->value_index = (uint32_t)(value_offset / VALUESIZE(*ht));
+#else
+			key->value_ptr = (char*)(uintptr_t)value_offset;
+#endif
+			value_offset += VALUESIZE(*ht);
+		} else {
+			set_slot_value(ht, key, NULL);
+		}
+		if(fwrite(key, KEYSIZE(*ht), 1, file) != 1) {
+			return false;
+		}
+	}
+
+	if(ctrl_bytes != 0
+		&& (!StremSnapshot_pad(file, header.keys_offset + keys_bytes, header.ctrl_offset)
+			|| fwrite(ht->ctrl, 1, ctrl_bytes, file) != ctrl_bytes)
+	) {
+		return false;
+	}
+	if(!StremSnapshot_pad(
+		file, ctrl_bytes != 0 ? header.ctrl_offset + ctrl_bytes : header.keys_offset + keys_bytes,
+		header.values_offset
+	)) {
+		return false;
+	}
+
+	char value_buf[VALUESIZE(*ht)];
+	memset(value_buf, 0, sizeof(value_buf));
+	for(size_t i = 0; i < cap; i++) {
+		StremHTKey* const ht_key = get_key(ht, i);
+		if(ht_key->type != STREM_HT_TAKEN) {
+			continue;
+		}
+		memcpy(value_buf, slot_value(ht, ht_key), ht->value_size);
+		if(fwrite(value_buf, sizeof(value_buf), 1, file) != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+StremHashTable StremHashTable_snapshot_view(
+	void const* buf,
+	size_t buf_size,
+	uint64_t hash_seed,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+) {
+	StremSnapshotHeader const* const header = buf;
+	StremHashTable ht = { 0 };
+
+	ht.key_size = key_size;
+	ht.value_size = value_size;
+	if(!StremSnapshot_valid(
+		header, buf_size, STREM_SNAPSHOT_HT_MAGIC, sizeof(StremHTKey), hash_seed, key_size, value_size
+	) || header->mode > STREM_HT_ROBIN_HOOD
+		|| header->size >= header->cap
+		|| !StremIndex_valid((size_t)header->cap, header->index_policy, header->probe_seq)
+		|| header->values_offset == 0
+		|| header->keys_offset + header->cap * KEYSIZE(ht) > header->total_size
+		|| header->values_offset + header->size * VALUESIZE(ht) > header->total_size
+		|| (header->mode == STREM_HT_GROUP
+			&& (header->ctrl_offset == 0
+				|| header->ctrl_offset + header->cap + STREM_GROUP_WIDTH - 1 > header->total_size))
+	) {
+		return ht;
+	}
+
+	/* view is never written, const is dropped only to fit the table */
+	ht.keys.elem_size = KEYSIZE(ht);
+	ht.keys.capacity_elems = (size_t)header->cap;
+	ht.keys.size = (size_t)header->size;
+	ht.keys.content = (char*)buf + header->keys_offset;
+	ht.ctrl = header->mode == STREM_HT_GROUP ? (uint8_t*)buf + header->ctrl_offset : NULL;
+	ht.value_base = (char*)buf + header->values_offset;
+	ht.func = func != NULL ? func : StremHash_for_size(key_size);
+	ht.cmp_func = cmp_func != NULL ? cmp_func : StremCmp_for_size(key_size);
+	ht.saturation = DEFAULT_HT_SATURATION;
+	ht.mode = (int)header->mode;
+	ht.index_policy = (int)header->index_policy;
+	ht.probe_seq = (int)header->probe_seq;
+	return ht;
+}
+
+static StremHTKey* key_at_group(StremHashTable* ht, void const* key, size_t hash) {
 	const size_t keys_cap = ht->keys.capacity_elems;
-	size_t index = hash % ht->keys.capacity_elems;
-	StremHTKey* ht_key = get_key(ht, index);
+	const uint8_t tag = StremGroup_tag(hash);
+	size_t index = home_index(ht, hash);
+
+	/* Tag match = check hashes and cmp
+	 * No match, but group has empty slot = return null
+	 * Otherwise continue with the next group
+	 */
+	STREM_COUNT(ht, lookups, 1);
+	for(size_t probe = 1;; probe++) {
+		uint8_t const* const group = ht->ctrl + index;
+		STREM_COUNT(ht, probes, 1);
 
+		for(StremGroupMask match = StremGroup_match(group, tag); match != 0; StremGroupMask_drop(match)) {
+			size_t key_index = index + StremGroupMask_next(match);
+			key_index = key_index < keys_cap ? key_index : key_index - keys_cap;
+
+			StremHTKey* const ht_key = get_key(ht, key_index);
+			if(keys_equal(ht, ht_key, key, hash)) {
+				return ht_key;
+			}
+		}
+		if(StremGroup_match_empty(group) != 0) {
+			return NULL;
+		}
+		index = probe_index(ht, index, probe, STREM_GROUP_WIDTH);
+	}
+}
+
+static StremHTKey* key_at_robin_hood(StremHashTable* ht, void const* key, size_t hash) {
+	size_t index = home_index(ht, hash);
+
+	/* Empty = return null
+	 * Key closer to its home than we are to ours = return null,
+	 * 	insertion would have taken its place
+	 * Otherwise check hashes and cmp
+	 *
+	 * Dead slots are met only in old arrays of incremental resize,
+	 * they keep psl of removed key, so the order still holds.
+	 */
+	STREM_COUNT(ht, lookups, 1);
+	for(unsigned int psl = 0;; psl++) {
+		StremHTKey* const ht_key = get_key(ht, index);
+		STREM_COUNT(ht, probes, 1);
+
+		if(ht_key->type == STREM_HT_EMPTY || psl_below(ht, ht_key, index, psl)) {
+			return NULL;
+		}
+		if(ht_key->type == STREM_HT_TAKEN && keys_equal(ht, ht_key, key, hash)) {
+			return ht_key;
+		}
+		index = next_index(ht, index);
+	}
+}
+
+// Shifts keys following the removed one back by one slot until a key on its home slot
+static void remove_backward_shift(StremHashTable* ht, StremHTKey* ht_key) {
+	const size_t key_size = KEYSIZE(*ht);
+	size_t index = ((char*)ht_key - (char*)ht->keys.content) / key_size;
+	StremHTKey* next_key = get_key(ht, next_index(ht, index));
+
+	while(next_key->type == STREM_HT_TAKEN && next_key->psl != 0) {
+		const unsigned int psl = slot_psl(ht, next_key, next_index(ht, index));
+		memcpy(ht_key, next_key, key_size);
+		set_psl(ht_key, psl - 1);
+
+		index = next_index(ht, index);
+		ht_key = next_key;
+		next_key = get_key(ht, next_index(ht, index));
+	}
+	ht_key->type = STREM_HT_EMPTY;
+	set_slot_value(ht, ht_key, NULL);
+}
+
+static StremHTKey* key_at_hashed(StremHashTable* ht, void const* key, size_t hash) {
+	if(PROBING(*ht) == STREM_HT_GROUP) {
+		return key_at_group(ht, key, hash);
+	} else if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		return key_at_robin_hood(ht, key, hash);
+	}
+
+	size_t index = home_index(ht, hash);
+	StremHTKey* ht_key = get_key(ht, index);
 
 	/* Dead = continue
 	 * Empty = return null
@@ -157,16 +692,17 @@ static StremHTKey* key_at(StremHashTable* ht, void const* key) {
 	 * 		if cmp == then return ptr
 	 */
 	// using index and ht_key separately for clarity
-	while(true) {
+	STREM_COUNT(ht, lookups, 1);
+	for(size_t probe = 1;; probe++) {
+		STREM_COUNT(ht, probes, 1);
 		if(ht_key->type == STREM_HT_EMPTY) {
 			return NULL;
 		}
 		if(ht_key->type == STREM_HT_DEAD
 		|| (ht_key->type == STREM_HT_TAKEN 
-//			&& !keys_equal(ht->cmp_func, key, &ht_key->content)
-			&& (hash != ht_key->hash || !ht->cmp_func(ht_key->content, key))
+			&& !keys_equal(ht, ht_key, key, hash)
 		)) {
-			index = (index + GAP) % keys_cap;
+			index = probe_index(ht, index, probe, 1);
 			ht_key = get_key(ht, index);
 		} else {
 			return ht_key;
@@ -174,61 +710,815 @@ static StremHTKey* key_at(StremHashTable* ht, void const* key) {
 	}
 }
 
+// Makes old arrays of incremental resize current and vice versa,
+// so the probing helpers may be used on old arrays
+static void swap_generations(StremHashTable* ht) {
+	void* const content = ht->keys.content;
+	const size_t cap = ht->keys.capacity_elems;
+	uint8_t* const ctrl = ht->ctrl;
+
+	ht->keys.content = ht->old_keys.content;
+	ht->keys.capacity_elems = ht->old_keys.capacity_elems;
+	ht->ctrl = ht->old_ctrl;
+	ht->old_keys.content = content;
+	ht->old_keys.capacity_elems = cap;
+	ht->old_ctrl = ctrl;
+}
+
+// Marks key dead, also used for old slots of incremental resize
+static void kill_key(StremHashTable* ht, StremHTKey* ht_key) {
+	ht_key->type = STREM_HT_DEAD;
+	set_slot_value(ht, ht_key, NULL);
+
+	if(PROBING(*ht) == STREM_HT_GROUP) {
+		const size_t index = ((char*)ht_key - (char*)ht->keys.content) / KEYSIZE(*ht);
+		StremGroup_set(ht->ctrl, ht->keys.capacity_elems, index, STREM_CTRL_DEAD);
+	}
+}
+
+// Moves up to slot_count old slots to the current arrays.
+// Moved slots are marked dead, so chains through them stay intact.
+static void migrate(StremHashTable* ht, size_t slot_count) {
+	const size_t key_size = KEYSIZE(*ht);
+	const size_t oldcap = ht->old_keys.capacity_elems;
+	const size_t end = oldcap - ht->migrated <= slot_count ? oldcap : ht->migrated + slot_count;
+	KEYBUF(key_buf, *ht);
+
+	for(; ht->migrated < end; ht->migrated++) {
+		StremHTKey* const old_key = (StremHTKey*)((char*)ht->old_keys.content + key_size*ht->migrated);
+		if(old_key->type != STREM_HT_TAKEN) {
+			continue;
+		}
+
+		memcpy(key_buf, old_key, key_size);
+		place_key(ht, (StremHTKey*)key_buf);
+
+		swap_generations(ht);
+		kill_key(ht, old_key);
+		swap_generations(ht);
+	}
+
+	if(ht->migrated == oldcap) {
+		StremVector_free(&ht->old_keys);
+		StremAllocator_free(ht->allocator, ht->old_ctrl);
+		ht->old_ctrl = NULL;
+	}
+}
+
+// Allocates new arrays, current ones become old. Does nothing if fails to allocate.
+static void start_migration(StremHashTable* ht, size_t newcap) {
+	StremVector newkeys = StremVector_construct_with(KEYSIZE(*ht), newcap, ht->allocator);
+	uint8_t* newctrl = NULL;
+	if(newkeys.content == NULL) {
+		return;
+	}
+	if(PROBING(*ht) == STREM_HT_GROUP && (newctrl = ctrl_construct(ht->allocator, newcap)) == NULL) {
+		StremVector_free(&newkeys);
+		return;
+	}
+
+	newkeys.size = ht->keys.size;
+	ht->old_keys = ht->keys;
+	ht->old_ctrl = ht->ctrl;
+	ht->keys = newkeys;
+	ht->ctrl = newctrl;
+	ht->tombstones = 0;
+	ht->migrated = 0;
+	ht->resizes++;
+}
+
+// Looks in old arrays too, if resizing incrementally
+static StremHTKey* key_at_any(StremHashTable* ht, void const* key, size_t hash) {
+	StremHTKey* ht_key = key_at_hashed(ht, key, hash);
+
+	if(ht_key == NULL && MIGRATING(*ht)) {
+		swap_generations(ht);
+		ht_key = key_at_hashed(ht, key, hash);
+		swap_generations(ht);
+	}
+	return ht_key;
+}
+
+static StremHTKey* key_at(StremHashTable* ht, void const* key, size_t hash) {
+	if(MIGRATING(*ht)) {
+		migrate(ht, MIGRATE_STEP);
+	}
+
+	return key_at_any(ht, key, hash);
+}
+
+static char* value_of(StremHashTable* ht, StremHTKey* ht_key) {
+	if(ht->value_base != NULL) {
+#ifdef STREM_HT_COMPACT
+		return ht->value_base + (size_t)ht_key->value_index * VALUESIZE(*ht);
+#else
+		return ht->value_base + (uintptr_t)ht_key->value_ptr;
+#endif
+	}
+	return slot_value(ht, ht_key);
+}
+
+static void prefetch_home(StremHashTable* ht, size_t hash) {
+	const size_t index = home_index(ht, hash);
+
+	if(PROBING(*ht) == STREM_HT_GROUP) {
+		__builtin_prefetch(ht->ctrl + index);
+	}
+	__builtin_prefetch(get_key(ht, index));
+}
+
+void StremHashTable_at_batch(
+	StremHashTable* ht, void const* keys, size_t count, void** values_out
+) {
+	size_t hashes[BATCH_CHUNK];
+	char const* chunk = keys;
+
+	if(MIGRATING(*ht)) {
+		migrate(ht, MIGRATE_STEP);
+	}
+
+	/* Hashing and prefetching the whole chunk first,
+	 * so cache misses of its home slots overlap */
+	for(size_t done = 0; done < count; done += BATCH_CHUNK) {
+		const size_t chunk_size = count - done < BATCH_CHUNK ? count - done : BATCH_CHUNK;
+
+		for(size_t i = 0; i < chunk_size; i++) {
+			hashes[i] = hash_key(ht, chunk + i*ht->key_size);
+			prefetch_home(ht, hashes[i]);
+		}
+		for(size_t i = 0; i < chunk_size; i++) {
+			StremHTKey* const ht_key = key_at_any(ht, chunk + i*ht->key_size, hashes[i]);
+			values_out[done + i] = ht_key != NULL ? value_of(ht, ht_key) : NULL;
+		}
+
+		chunk += chunk_size*ht->key_size;
+	}
+}
+
 void* StremHashTable_at(StremHashTable* ht, void const* key) {
-	StremHTKey* ht_key = key_at(ht, key);
+	return StremHashTable_at_hashed(ht, key, hash_key(ht, key));
+}
+
+void* StremHashTable_at_hashed(StremHashTable* ht, void const* key, size_t hash) {
+	StremHTKey* ht_key = key_at(ht, key, hash);
 
 	if(ht_key == NULL) {
 		return NULL;
 	}
-	return ht_key->value_ptr;
+	return value_of(ht, ht_key);
 }
 
-void* StremHashTable_insert(StremHashTable* ht, void const* const key, void const* const value) {
-	const float current_satur = (float)ht->keys.size / ht->keys.capacity_elems;
-	if(current_satur >= ht->saturation) {
-		StremHashTable_resize(ht, ht->keys.capacity_elems * 2);
+static void push_free_value(StremHashTable* ht, char* value_ptr) {
+	StremSegrLine_FreeNode* const node = (StremSegrLine_FreeNode*)value_ptr;
+	node->next = ht->free_values;
+	ht->free_values = node;
+}
+
+// Pushes value of the last removed pair to free chain
+static void release_removed_value(StremHashTable* ht) {
+	if(ht->removed_value != NULL) {
+		push_free_value(ht, ht->removed_value);
+		ht->removed_value = NULL;
 	}
+}
 
-	const size_t hash = ht->func(key);
-	size_t key_index = hash % ht->keys.capacity_elems;
-	StremHTKey* ht_key = get_key(ht, key_index);
+// Allocates value block and pushes its slots to free chain.
+// Block is as big as all previous ones together, so blocks count stays logarithmic.
+// Returns false if fails to allocate.
+static bool grow_values(StremHashTable* ht) {
+	const size_t block_cap = ht->value_cap != 0 ? ht->value_cap : DEFAULT_HT_CAP;
+#ifdef STREM_HT_COMPACT
+	if((uint64_t)ht->value_cap + block_cap > (uint64_t)UINT32_MAX + 1) {
+		return false;
+	}
+#endif
+	char* const block = StremSegrLine_alloc_with(ht->allocator, VALUESIZE(*ht), block_cap);
+	if(block == NULL) {
+		return false;
+	}
+	if(StremVector_push(&ht->value_blocks, &block, 1) == NULL) {
+		StremAllocator_free(ht->allocator, block);
+		return false;
+	}
 
-	while(ht_key->type == STREM_HT_TAKEN) {
-		key_index = (key_index + GAP) % ht->keys.capacity_elems;
-		ht_key = get_key(ht, key_index);
+	/* chain of block ends with NULL, the rest of free chain follows it */
+	((StremSegrLine_FreeNode*)(block + (block_cap - 1) * VALUESIZE(*ht)))->next = ht->free_values;
+	ht->free_values = (StremSegrLine_FreeNode*)block;
+	ht->value_cap += block_cap;
+	return true;
+}
+
+// Pops value slot from free chain, allocating new block if chain is empty
+static char* alloc_value(StremHashTable* ht) {
+	release_removed_value(ht);
+
+	if(ht->free_values == NULL && !grow_values(ht)) {
+		return NULL;
 	}
 
-	void* value_ptr;
-	if(ht->dead_values.size != 0) {
-		value_ptr = StremVectorPopBack(ht->dead_values, void*);
-		memcpy(value_ptr, value, ht->value_size);
-	} else {
-		StremVector_push(&ht->values, value, 1);
-		value_ptr = StremVectorErasedAt(ht->values, ht->values.size - 1);
+	char* const value_ptr = (char*)ht->free_values;
+	ht->free_values = ht->free_values->next;
+	return value_ptr;
+}
+
+// Value stays readable until the next insert or remove
+static void free_value(StremHashTable* ht, char* value_ptr) {
+	release_removed_value(ht);
+	ht->removed_value = value_ptr;
+}
+
+// Moves a migration step, then grows table if live and dead slots saturate it.
+// If most of them are dead, they're purged instead and capacity stays.
+static void prepare_insert(StremHashTable* ht) {
+	if(MIGRATING(*ht)) {
+		migrate(ht, MIGRATE_STEP);
+	}
+
+	const size_t cap = ht->keys.capacity_elems;
+	const float current_satur = (float)(ht->keys.size + ht->tombstones) / cap;
+	if(current_satur >= ht->saturation) {
+		const bool mostly_dead = (float)ht->keys.size / cap < ht->saturation / 2;
+		if(ht->mode & STREM_HT_INCREMENTAL) {
+			if(MIGRATING(*ht)) {
+				migrate(ht, STREM_SIZE_MAX);
+			}
+			/* same-capacity migration drops dead slots a step at a time, as growth does */
+			start_migration(ht, mostly_dead ? cap : cap * 2);
+		} else if(mostly_dead) {
+			StremHashTable_purge(ht);
+		} else {
+			StremHashTable_resize(ht, cap * 2);
+		}
 	}
+}
+
+// Writes new key to free slot index, size and tombstones are left to caller
+static void fill_slot(StremHashTable* ht, size_t index, void const* key, size_t hash, char* value_ptr) {
+	StremHTKey* const ht_key = get_key(ht, index);
 
-	ht_key->hash = hash;
+	ht_key->hash = FINGERPRINT(hash);
 	ht_key->type = STREM_HT_TAKEN;
-	ht_key->value_ptr = value_ptr;
+	set_slot_value(ht, ht_key, value_ptr);
 	memcpy(&ht_key->content, key, ht->key_size);
+	take_slot(ht, index, hash);
+}
+
+// Puts new key into slot index found by probing.
+// For robin hood, psl is distance of index from home slot.
+static void insert_at(
+	StremHashTable* ht, 
+	void const* key, 
+	size_t hash, 
+	char* value_ptr, 
+	size_t index, 
+	unsigned int psl
+) {
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		KEYBUF(new_key_buf, *ht);
+		StremHTKey* const new_key = (StremHTKey*)new_key_buf;
+
+		new_key->hash = FINGERPRINT(hash);
+		new_key->type = STREM_HT_TAKEN;
+		set_slot_value(ht, new_key, value_ptr);
+		memcpy(&new_key->content, key, ht->key_size);
+		place_robin_hood_at(ht, new_key, index, psl);
+	} else {
+		if(get_key(ht, index)->type == STREM_HT_DEAD) {
+			ht->tombstones--;
+		}
+		fill_slot(ht, index, key, hash, value_ptr);
+	}
 	ht->keys.size++;
+}
 
-	return ht_key->value_ptr;
+void* StremHashTable_insert(StremHashTable* ht, void const* const key, void const* const value) {
+	prepare_insert(ht);
+
+	const size_t hash = hash_key(ht, key);
+
+	char* const value_ptr = alloc_value(ht);
+	if(value_ptr == NULL) {
+		return NULL;
+	}
+	memcpy(value_ptr, value, ht->value_size);
+
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		insert_at(ht, key, hash, value_ptr, home_index(ht, hash), 0);
+	} else {
+		insert_at(ht, key, hash, value_ptr, free_index(ht, hash), 0);
+	}
+	return value_ptr;
+}
+
+// Looks for key in current arrays only.
+// If not found, returns NULL and sets index (and psl for robin hood)
+// to the place where key should be inserted.
+static StremHTKey* find_or_locate(
+	StremHashTable* ht, void const* key, size_t hash, size_t* at_index, unsigned int* at_psl
+) {
+	const size_t keys_cap = ht->keys.capacity_elems;
+	size_t index = home_index(ht, hash);
+	size_t free = STREM_SIZE_MAX;
+
+	STREM_COUNT(ht, lookups, 1);
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		for(unsigned int psl = 0;; psl++) {
+			StremHTKey* const ht_key = get_key(ht, index);
+			STREM_COUNT(ht, probes, 1);
+
+			if(ht_key->type != STREM_HT_TAKEN || psl_below(ht, ht_key, index, psl)) {
+				*at_index = index;
+				*at_psl = psl;
+				return NULL;
+			}
+			if(keys_equal(ht, ht_key, key, hash)) {
+				return ht_key;
+			}
+			index = next_index(ht, index);
+		}
+	} else if(PROBING(*ht) == STREM_HT_GROUP) {
+		const uint8_t tag = StremGroup_tag(hash);
+
+		for(size_t probe = 1;; probe++) {
+			uint8_t const* const group = ht->ctrl + index;
+			STREM_COUNT(ht, probes, 1);
+
+			for(StremGroupMask match = StremGroup_match(group, tag); match != 0; StremGroupMask_drop(match)) {
+				size_t key_index = index + StremGroupMask_next(match);
+				key_index = key_index < keys_cap ? key_index : key_index - keys_cap;
+
+				StremHTKey* const ht_key = get_key(ht, key_index);
+				if(keys_equal(ht, ht_key, key, hash)) {
+					return ht_key;
+				}
+			}
+			const StremGroupMask free_mask = StremGroup_match_free(group);
+			if(free == STREM_SIZE_MAX && free_mask != 0) {
+				free = index + StremGroupMask_next(free_mask);
+				free = free < keys_cap ? free : free - keys_cap;
+			}
+			if(StremGroup_match_empty(group) != 0) {
+				*at_index = free;
+				return NULL;
+			}
+			index = probe_index(ht, index, probe, STREM_GROUP_WIDTH);
+		}
+	}
+
+	for(size_t probe = 1;; probe++) {
+		StremHTKey* const ht_key = get_key(ht, index);
+		STREM_COUNT(ht, probes, 1);
+
+		if(ht_key->type != STREM_HT_TAKEN && free == STREM_SIZE_MAX) {
+			free = index;
+		}
+		if(ht_key->type == STREM_HT_EMPTY) {
+			*at_index = free;
+			return NULL;
+		}
+		if(ht_key->type == STREM_HT_TAKEN 
+			&& keys_equal(ht, ht_key, key, hash)
+		) {
+			return ht_key;
+		}
+		index = probe_index(ht, index, probe, 1);
+	}
+}
+
+static void* find_or_insert_hashed(StremHashTable* ht, void const* key, size_t hash, bool* inserted) {
+	prepare_insert(ht);
+
+	size_t at_index = 0;
+	unsigned int at_psl = 0;
+	StremHTKey* ht_key = find_or_locate(ht, key, hash, &at_index, &at_psl);
+
+	if(ht_key == NULL && MIGRATING(*ht)) {
+		swap_generations(ht);
+		ht_key = key_at_hashed(ht, key, hash);
+		swap_generations(ht);
+	}
+	if(ht_key != NULL) {
+		*inserted = false;
+		return slot_value(ht, ht_key);
+	}
+
+	char* const value_ptr = alloc_value(ht);
+	if(value_ptr == NULL) {
+		return NULL;
+	}
+	insert_at(ht, key, hash, value_ptr, at_index, at_psl);
+
+	*inserted = true;
+	return value_ptr;
+}
+
+void* StremHashTable_find_or_insert(StremHashTable* ht, void const* key, bool* inserted) {
+	return find_or_insert_hashed(ht, key, hash_key(ht, key), inserted);
+}
+
+void* StremHashTable_upsert(
+	StremHashTable* ht, void const* key, void const* value, StremMergeFunction merge
+) {
+	return StremHashTable_upsert_hashed(ht, key, hash_key(ht, key), value, merge);
+}
+
+void* StremHashTable_upsert_hashed(
+	StremHashTable* ht, void const* key, size_t hash, void const* value, StremMergeFunction merge
+) {
+	bool inserted;
+	void* const value_ptr = find_or_insert_hashed(ht, key, hash, &inserted);
+
+	if(value_ptr == NULL) {
+		return NULL;
+	} else if(inserted || merge == NULL) {
+		memcpy(value_ptr, value, ht->value_size);
+	} else {
+		merge(value_ptr, value);
+	}
+	return value_ptr;
+}
+
+bool StremHashTable_reserve(StremHashTable* ht, size_t count) {
+	size_t cap = ht->keys.capacity_elems;
+	while((float)count > cap * ht->saturation) {
+		cap *= 2;
+	}
+
+	/* finishes incremental resize even if capacity is enough */
+	StremHashTable_resize(ht, cap);
+	if(ht->keys.capacity_elems < cap) {
+		return false;
+	}
+	if((float)(count + ht->tombstones) > cap * ht->saturation) {
+		StremHashTable_purge(ht);
+	}
+
+	while(ht->value_cap < count + (ht->removed_value != NULL)) {
+		if(!grow_values(ht)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Tuples from begin to end are placed by one thread, only to slots before slot_end
+typedef struct {
+	StremHashTable* ht;
+	char* tuples;
+	char** value_ptrs; /* by number of tuple */
+	size_t begin;
+	size_t end;
+	size_t slot_end;
+	size_t deferred_end; /* tuples from begin to it met slot_end, they're placed afterwards */
+	size_t dead_reused;
+} BulkRange;
+
+// Without triangular probing free_index returns the first free slot after home one,
+// so keys of disjoint slot ranges may be placed in parallel
+static bool probes_adjacent(StremHashTable* ht) {
+	return (PROBING(*ht) == STREM_HT_LINEAR && ht->probe_seq == STREM_SEQ_LINEAR)
+		|| (PROBING(*ht) == STREM_HT_GROUP && ht->probe_seq != STREM_SEQ_TRIANGULAR);
+}
+
+static void* bulk_fill_range(void* arg) {
+	BulkRange* const range = arg;
+	StremHashTable* const ht = range->ht;
+	const size_t tuple_size = TUPLESIZE(*ht);
+	size_t deferred = range->begin;
+
+	for(size_t i = range->begin; i < range->end; i++) {
+		char const* const tuple = range->tuples + tuple_size * i;
+		char* const value_ptr = range->value_ptrs[i];
+		size_t hash;
+		memcpy(&hash, tuple, sizeof(size_t));
+
+		size_t index = home_index(ht, hash);
+		while(index < range->slot_end && get_key(ht, index)->type == STREM_HT_TAKEN) {
+			index++;
+		}
+		if(index == range->slot_end) {
+			if(deferred != i) {
+				memcpy(range->tuples + tuple_size * deferred, tuple, tuple_size);
+				range->value_ptrs[deferred] = value_ptr;
+			}
+			deferred++;
+			continue;
+		}
+
+		if(get_key(ht, index)->type == STREM_HT_DEAD) {
+			range->dead_reused++;
+		}
+		memcpy(value_ptr, tuple + sizeof(size_t) + ht->key_size, ht->value_size);
+		fill_slot(ht, index, tuple + sizeof(size_t), hash, value_ptr);
+	}
+	range->deferred_end = deferred;
+	return NULL;
+}
+
+// Copies value of tuple to value_ptr and inserts its key, probing as insert does
+static void bulk_insert_tuple(StremHashTable* ht, char const* tuple, char* value_ptr) {
+	size_t hash;
+	memcpy(&hash, tuple, sizeof(size_t));
+	memcpy(value_ptr, tuple + sizeof(size_t) + ht->key_size, ht->value_size);
+	insert_at(
+		ht, tuple + sizeof(size_t), hash, value_ptr,
+		PROBING(*ht) == STREM_HT_ROBIN_HOOD ? home_index(ht, hash) : free_index(ht, hash), 0
+	);
+}
+
+// Splits sorted tuples between threads by buckets, each places keys of its buckets
+// to their slot range. Keys which would probe past the range are placed afterwards.
+static void bulk_fill(
+	StremHashTable* ht, char* tuples, char** value_ptrs,
+	size_t const* bucket_ends, size_t bucket_count, size_t bucket_width, size_t threads
+) {
+	BulkRange ranges[MAX_THREADS];
+	pthread_t ids[MAX_THREADS];
+	bool started[MAX_THREADS];
+	const size_t count = bucket_ends[bucket_count - 1];
+
+	for(size_t t = 0; t < threads; t++) {
+		const size_t first = t * bucket_count / threads;
+		const size_t last = (t + 1) * bucket_count / threads;
+		const size_t begin = first != 0 ? bucket_ends[first - 1] : 0;
+		ranges[t] = (BulkRange){
+			ht,
+			tuples,
+			value_ptrs,
+			begin,
+			bucket_ends[last - 1],
+			last < bucket_count ? last * bucket_width : ht->keys.capacity_elems,
+			begin,
+			0
+		};
+		started[t] = t != 0 && pthread_create(&ids[t], NULL, bulk_fill_range, &ranges[t]) == 0;
+	}
+
+	/* ranges of threads which failed to start are filled by this one */
+	size_t deferred = 0;
+	size_t dead_reused = 0;
+	for(size_t t = 0; t < threads; t++) {
+		if(started[t]) {
+			pthread_join(ids[t], NULL);
+		} else {
+			bulk_fill_range(&ranges[t]);
+		}
+		deferred += ranges[t].deferred_end - ranges[t].begin;
+		dead_reused += ranges[t].dead_reused;
+	}
+	ht->keys.size += count - deferred;
+	ht->tombstones -= dead_reused;
+
+	for(size_t t = 0; t < threads; t++) {
+		for(size_t i = ranges[t].begin; i < ranges[t].deferred_end; i++) {
+			bulk_insert_tuple(ht, tuples + TUPLESIZE(*ht) * i, value_ptrs[i]);
+		}
+	}
+}
+
+bool StremHashTable_insert_bulk(
+	StremHashTable* ht, void const* keys, void const* values, size_t count, size_t threads
+) {
+	if(!StremHashTable_reserve(ht, ht->keys.size + count)) {
+		return false;
+	}
+	if(count == 0) {
+		return true;
+	}
+
+	const size_t cap = ht->keys.capacity_elems;
+	const size_t bucket_width = (cap + BULK_BUCKETS - 1) / BULK_BUCKETS;
+	const size_t bucket_count = (cap + bucket_width - 1) / bucket_width;
+	const size_t tuple_size = TUPLESIZE(*ht);
+	char const* const key_bytes = keys;
+	char const* const value_bytes = values;
+	size_t* const hashes = StremAllocator_alloc(ht->allocator, count * sizeof(size_t));
+	char* const tuples = StremAllocator_alloc(ht->allocator, count * tuple_size);
+	size_t* const bucket_ends = StremAllocator_calloc(ht->allocator, bucket_count, sizeof(size_t));
+	if(hashes == NULL || tuples == NULL || bucket_ends == NULL) {
+		StremAllocator_free(ht->allocator, hashes);
+		StremAllocator_free(ht->allocator, tuples);
+		StremAllocator_free(ht->allocator, bucket_ends);
+		return false;
+	}
+
+	/* Hashing in a tight loop, then copying pairs to tuples sorted by bucket of home slot
+	 * (counting sort), so slots are written in order and input is read in order */
+	for(size_t i = 0; i < count; i++) {
+		hashes[i] = hash_key(ht, key_bytes + i * ht->key_size);
+		bucket_ends[home_index(ht, hashes[i]) / bucket_width]++;
+	}
+	for(size_t b = 0, begin = 0; b < bucket_count; b++) {
+		const size_t rows_in_bucket = bucket_ends[b];
+		bucket_ends[b] = begin;
+		begin += rows_in_bucket;
+	}
+	for(size_t i = 0; i < count; i++) {
+		char* const tuple = tuples + tuple_size * bucket_ends[home_index(ht, hashes[i]) / bucket_width]++;
+		memcpy(tuple, &hashes[i], sizeof(size_t));
+		memcpy(tuple + sizeof(size_t), key_bytes + i * ht->key_size, ht->key_size);
+		memcpy(tuple + sizeof(size_t) + ht->key_size, value_bytes + i * ht->value_size, ht->value_size);
+	}
+
+	/* hashes are in tuples now, their array holds value slots taken in sorted order */
+	char** const value_ptrs = (char**)hashes;
+	for(size_t i = 0; i < count; i++) {
+		value_ptrs[i] = alloc_value(ht);
+		assert(value_ptrs[i] != NULL && "Value storage is reserved");
+	}
+
+	const size_t max_threads = count / BULK_THREAD_ROWS;
+	threads = threads < max_threads ? threads : max_threads;
+	threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+	if(threads > 1 && probes_adjacent(ht)) {
+		bulk_fill(ht, tuples, value_ptrs, bucket_ends, bucket_count, bucket_width, threads);
+	} else {
+		for(size_t i = 0; i < count; i++) {
+			bulk_insert_tuple(ht, tuples + tuple_size * i, value_ptrs[i]);
+		}
+	}
+
+	StremAllocator_free(ht->allocator, hashes);
+	StremAllocator_free(ht->allocator, tuples);
+	StremAllocator_free(ht->allocator, bucket_ends);
+	return true;
 }
 
 void* StremHashTable_remove(StremHashTable* ht, void const* key) {
-	StremHTKey* ht_key = key_at(ht, key);
+	if(MIGRATING(*ht)) {
+		migrate(ht, MIGRATE_STEP);
+	}
+
+	const size_t hash = hash_key(ht, key);
+	StremHTKey* ht_key = key_at_hashed(ht, key, hash);
+	char* value_ptr;
+
+	if(ht_key == NULL && MIGRATING(*ht)) {
+		/* old arrays are never shifted, key is just marked dead */
+		swap_generations(ht);
+		ht_key = key_at_hashed(ht, key, hash);
+		if(ht_key != NULL) {
+			value_ptr = slot_value(ht, ht_key);
+			kill_key(ht, ht_key);
+		}
+		swap_generations(ht);
+
+		if(ht_key == NULL) {
+			return NULL;
+		}
+		free_value(ht, value_ptr);
+		ht->keys.size--;
+		return value_ptr;
+	}
 
 	if(ht_key == NULL || ht_key->type != STREM_HT_TAKEN) {
 		return NULL;
 	}
 
-	void* value_ptr = ht_key->value_ptr;
-	StremVector_push(&ht->dead_values, &value_ptr, 1);
-	ht_key->type = STREM_HT_DEAD;
-	ht_key->value_ptr = NULL;
+	value_ptr = slot_value(ht, ht_key);
+	free_value(ht, value_ptr);
 
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		remove_backward_shift(ht, ht_key);
+	} else {
+		kill_key(ht, ht_key);
+		ht->tombstones++;
+	}
 	ht->keys.size--;
 
 	return value_ptr;
 }
+
+// Erases matching pairs in one pass over slots. Every kept key is shifted back over
+// erased ones as far as its home slot allows, so no dead slots are left and order holds.
+// Pass starts at empty slot or key on its home slot, no key before it has home after it.
+static size_t erase_robin_hood(StremHashTable* ht, StremPairPredicate pred, void* ctx) {
+	const size_t cap = ht->keys.capacity_elems;
+	const size_t key_size = KEYSIZE(*ht);
+	size_t start = 0;
+	size_t erased = 0;
+	size_t write = 0; /* offset from start, kept keys are placed before it */
+
+	while(get_key(ht, start)->type == STREM_HT_TAKEN && get_key(ht, start)->psl != 0) {
+		start++;
+	}
+
+	for(size_t offset = 0; offset < cap; offset++) {
+		const size_t index = start + offset < cap ? start + offset : start + offset - cap;
+		StremHTKey* const ht_key = get_key(ht, index);
+		if(ht_key->type != STREM_HT_TAKEN) {
+			continue;
+		}
+
+		if(pred(ht_key->content, slot_value(ht, ht_key), ctx)) {
+			push_free_value(ht, slot_value(ht, ht_key));
+			ht_key->type = STREM_HT_EMPTY;
+			set_slot_value(ht, ht_key, NULL);
+			erased++;
+			continue;
+		}
+
+		/* slots from write to offset are empty by now */
+		const size_t home = offset - slot_psl(ht, ht_key, index);
+		const size_t target = write > home ? write : home;
+		if(target != offset) {
+			StremHTKey* const moved = get_key(ht, start + target < cap ? start + target : start + target - cap);
+			memcpy(moved, ht_key, key_size);
+			set_psl(moved, (unsigned int)(target - home));
+			ht_key->type = STREM_HT_EMPTY;
+			set_slot_value(ht, ht_key, NULL);
+		}
+		write = target + 1;
+	}
+	return erased;
+}
+
+size_t StremHashTable_erase_if(StremHashTable* ht, StremPairPredicate pred, void* ctx) {
+	assert(ht->value_base == NULL && "Snapshot view can't be modified");
+	if(MIGRATING(*ht)) {
+		migrate(ht, STREM_SIZE_MAX);
+	}
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		const size_t erased = erase_robin_hood(ht, pred, ctx);
+		ht->keys.size -= erased;
+		return erased;
+	}
+
+	size_t erased = 0;
+	for(size_t i = 0; i < ht->keys.capacity_elems; i++) {
+		StremHTKey* const ht_key = get_key(ht, i);
+		if(ht_key->type == STREM_HT_TAKEN && pred(ht_key->content, slot_value(ht, ht_key), ctx)) {
+			push_free_value(ht, slot_value(ht, ht_key));
+			kill_key(ht, ht_key);
+			erased++;
+		}
+	}
+	ht->keys.size -= erased;
+	ht->tombstones += erased;
+
+	/* misses would probe more dead slots than live ones */
+	if(ht->tombstones > ht->keys.size) {
+		rehash_in_place(ht);
+	}
+	return erased;
+}
+
+// Number of probes from home slot (group) of key to index, cap if index isn't on its sequence
+static size_t probe_length(StremHashTable* ht, StremHTKey* ht_key, size_t index) {
+	if(PROBING(*ht) == STREM_HT_ROBIN_HOOD) {
+		return slot_psl(ht, ht_key, index);
+	}
+
+	const size_t cap = ht->keys.capacity_elems;
+	const size_t stride = PROBING(*ht) == STREM_HT_GROUP ? STREM_GROUP_WIDTH : 1;
+	size_t at = home_index(ht, slot_hash(ht, ht_key));
+
+	for(size_t probe = 0; probe < cap; probe++) {
+		const size_t offset = index >= at ? index - at : index + cap - at;
+		if(offset < stride) {
+			return probe;
+		}
+		at = probe_index(ht, at, probe + 1, stride);
+	}
+	return cap;
+}
+
+// Adds slots of current arrays to stats
+static void add_slot_stats(StremHashTable* ht, StremHashStats* stats) {
+	const size_t cap = ht->keys.capacity_elems;
+
+	for(size_t i = 0; i < cap; i++) {
+		StremHTKey* const ht_key = get_key(ht, i);
+		if(ht_key->type == STREM_HT_TAKEN) {
+			StremHashStats_add_probe(stats, probe_length(ht, ht_key, i));
+		} else if(ht_key->type == STREM_HT_DEAD) {
+			stats->tombstones++;
+		}
+	}
+	stats->cap += cap;
+	stats->key_bytes += cap * KEYSIZE(*ht) + (ht->ctrl != NULL ? cap + STREM_GROUP_WIDTH - 1 : 0);
+}
+
+StremHashStats StremHashTable_stats(StremHashTable* ht) {
+	StremHashStats stats = { 0 };
+
+	add_slot_stats(ht, &stats);
+	if(MIGRATING(*ht)) {
+		swap_generations(ht);
+		add_slot_stats(ht, &stats);
+		swap_generations(ht);
+	}
+
+	stats.size = ht->keys.size;
+	if(stats.size != 0) {
+		stats.avg_probe /= (double)stats.size;
+	}
+	stats.resizes = ht->resizes;
+	stats.value_bytes = ht->keys.size * VALUESIZE(*ht);
+	/* snapshot view holds just values of its keys */
+	stats.dead_value_bytes = ht->value_cap > ht->keys.size
+		? (ht->value_cap - ht->keys.size) * VALUESIZE(*ht)
+		: 0;
+	stats.counters = ht->counters;
+	return stats;
+}
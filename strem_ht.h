@@ -1,50 +1,229 @@
 #ifndef STREM_HT_H_
 #define STREM_HT_H_
+#include <stdint.h>
 #include "strem_vector.h"
+#include "strem_segr_line.h"
+#include "strem_index.h"
+#include "strem_snapshot.h"
+#include "strem_stats.h"
+#include "strem_hash.h"
 
+// Merges value into existing one: (existing, value)
+typedef void(*StremMergeFunction)(void*, void const*);
+// Tells if pair is to be erased: (key, value, ctx)
+typedef bool(*StremPairPredicate)(void const*, void*, void*);
 
-typedef size_t(*StremHashFunction)(void const*);
-typedef bool(*StremCmpFunction)(void const*, void const*);
+enum {
+	STREM_HT_EMPTY = 0,
+	STREM_HT_TAKEN,
+	STREM_HT_DEAD,
+};
 
+// Slot layout depends on STREM_HT_COMPACT, so tables are constructed by symbols
+// named after it: translation units built with and without it don't link together.
+#ifdef STREM_HT_COMPACT
+#define STREM_HT_LAYOUT(name) name##_compact
+#else
+#define STREM_HT_LAYOUT(name) name
+#endif
+#define StremHashTable_construct STREM_HT_LAYOUT(StremHashTable_construct)
+#define StremHashTable_construct_mode STREM_HT_LAYOUT(StremHashTable_construct_mode)
+#define StremHashTable_construct_policy STREM_HT_LAYOUT(StremHashTable_construct_policy)
+#define StremHashTable_construct_with STREM_HT_LAYOUT(StremHashTable_construct_with)
+#define StremHashTable_snapshot_view STREM_HT_LAYOUT(StremHashTable_snapshot_view)
+
+#ifdef STREM_HT_COMPACT
+// Robin hood probe lengths from it on are stored as it and recomputed from hash of key
+#define STREM_HT_MAX_PSL ((1u << 14) - 1)
+
+// Compact slot, opt-in by defining STREM_HT_COMPACT for every translation unit:
+// 8 bytes of header instead of 24, slot is padded to a power of two, so it never
+// straddles cache lines. Keys are rehashed by func on growth, since only the top bits
+// of hash are kept to skip cmp_func. Table holds at most UINT32_MAX values.
+typedef struct {
+	uint16_t hash; /* fingerprint: top 16 bits of hash */
+	uint16_t type : 2;
+	uint16_t psl : 14; /* STREM_HT_ROBIN_HOOD only: distance from home slot */
+	uint32_t value_index; /* number of value slot in value blocks */
+	char content[];
+} StremHTKey;
+#else
 typedef struct {
 	size_t hash;
-	enum {
-		STREM_HT_EMPTY = 0,
-		STREM_HT_TAKEN,
-		STREM_HT_DEAD,
-	} type;
+	unsigned int type;
+	unsigned int psl; /* STREM_HT_ROBIN_HOOD only: distance from home slot */
 	char* value_ptr;
 	char content[];
 } StremHTKey;
+#endif
+
+typedef enum {
+	// Probes slots GAP apart, checking type of every visited key
+	STREM_HT_LINEAR = 0,
+	// Probes STREM_GROUP_WIDTH control bytes at once (SSE2 if available),
+	// visiting keys only if their 7-bit hash tag matches
+	STREM_HT_GROUP,
+	// Probes adjacent slots, keeping keys ordered by distance from home slot.
+	// Remove shifts the chain back instead of leaving STREM_HT_DEAD slots.
+	STREM_HT_ROBIN_HOOD,
+
+	// Flag, may be or'ed with any of the above.
+	// Growth allocates new arrays and leaves old ones beside them,
+	// every further insert/at/remove moves a bounded number of old slots.
+	STREM_HT_INCREMENTAL = 0x10,
+} StremHTMode;
 
-// TODO: replace values and dead_values with one StremSegrLine and one pointer to free chain
 typedef struct {
 	/* private: */
 	StremVector /* StremHTKey + TKey */ keys;
-	StremVector /* TValue */ values;
-	StremVector /* void* */ dead_values;
+	uint8_t* ctrl; /* STREM_HT_GROUP only */
+	size_t tombstones; /* STREM_HT_DEAD slots of keys, they count towards saturation */
+	/* STREM_HT_INCREMENTAL only, content == NULL if not resizing: */
+	StremVector /* StremHTKey + TKey */ old_keys;
+	uint8_t* old_ctrl;
+	size_t migrated; /* old slots before this index are moved to keys */
+	/* Values live in StremSegrLine blocks, which are never moved,
+	 * so pointers to values stay valid until the pair is removed. */
+	StremVector /* char* */ value_blocks;
+	StremSegrLine_FreeNode* free_values;
+	char* removed_value; /* joins free chain on the next insert or remove */
+	size_t value_cap; /* value slots in all blocks */
+	/* snapshot view only, values of keys are offsets from it: */
+	char* value_base;
+	StremAllocator const* allocator; /* NULL for malloc */
 	StremHashFunction func;
 	StremCmpFunction cmp_func;
 	size_t key_size;
 	size_t value_size;
 	/* public: */
 	float saturation;
+	/* private: */
+	int mode;
+	int index_policy;
+	int probe_seq; /* ignored by STREM_HT_ROBIN_HOOD, which always probes adjacent slots */
+	size_t resizes;
+	StremHashCounters counters; /* STREM_HASH_COUNTERS only */
 } StremHashTable;
 
 
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h)
 StremHashTable StremHashTable_construct(
 	size_t key_size, size_t value_size, StremHashFunction func, StremCmpFunction cmp_func
 );
+// If fails to allocate, ht.keys.content == NULL
+StremHashTable StremHashTable_construct_mode(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func, 
+	StremCmpFunction cmp_func,
+	StremHTMode mode
+);
+// Capacity starts at a power of two and is doubled on growth,
+// so any index policy and probe sequence may be used.
+// Must: probe_seq != STREM_SEQ_TRIANGULAR or index_policy == STREM_INDEX_MASK
+// If fails to allocate, ht.keys.content == NULL
+StremHashTable StremHashTable_construct_policy(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func, 
+	StremCmpFunction cmp_func,
+	StremHTMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq
+);
+// Same, keys, control bytes and value blocks are allocated from allocator (NULL for malloc)
+StremHashTable StremHashTable_construct_with(
+	size_t key_size, 
+	size_t value_size, 
+	StremHashFunction func, 
+	StremCmpFunction cmp_func,
+	StremHTMode mode,
+	StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq,
+	StremAllocator const* allocator
+);
 void StremHashTable_free(StremHashTable* ht);
 
-// Inserts pair and returns pointer to value contained inside table
+// Writes table to file in snapshot format, hash_seed is stored to be checked by view.
+// Values are packed after keys, which refer to them by offset.
+// Returns false on write error.
+bool StremHashTable_snapshot_write(StremHashTable* ht, FILE* file, uint64_t hash_seed);
+
+// Table looking pairs up right in snapshot buf (e.g. mapped file), nothing is copied or rehashed.
+// Must: buf is aligned to STREM_SNAPSHOT_ALIGN and outlives the table;
+// only at and at_batch are called, free releases nothing.
+// If buf isn't a snapshot of such pairs written with hash_seed, ht.keys.content == NULL
+StremHashTable StremHashTable_snapshot_view(
+	void const* buf,
+	size_t buf_size,
+	uint64_t hash_seed,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func
+);
+
+// Inserts pair and returns pointer to value contained inside table.
+// Value pointer is valid until the pair is removed.
+// Returns NULL if fails to allocate value storage.
 void* StremHashTable_insert(StremHashTable* ht, void const* const key, void const* const value);
+// Returns pointer to value associated with key, inserting key with uninitialized value
+// if there's no such key. Sets *inserted accordingly. Probes table once.
+// Returns NULL if fails to allocate value storage.
+void* StremHashTable_find_or_insert(StremHashTable* ht, void const* key, bool* inserted);
+// Inserts copy of value if there's no key, otherwise merge(existing, value) is called
+// (value overwrites existing one if merge == NULL). Returns pointer to value inside table.
+// Returns NULL if fails to allocate value storage.
+void* StremHashTable_upsert(
+	StremHashTable* ht, void const* key, void const* value, StremMergeFunction merge
+);
+// Same with hash computed by caller, e.g. once for partitioning and insert.
+// Must: hash is what func of table (or built-in kernel) returns for key
+void* StremHashTable_upsert_hashed(
+	StremHashTable* ht, void const* key, size_t hash, void const* value, StremMergeFunction merge
+);
+// Grows keys and value storage, so that count pairs in total fit without growing.
+// Finishes incremental resize. Returns false if fails to allocate.
+bool StremHashTable_reserve(StremHashTable* ht, size_t count);
+// Inserts count pairs of keys and values stored contiguously, reserving room once.
+// Keys are hashed in one pass and sorted by home slot, so slots are written in order.
+// With threads > 1 (and probing other than robin hood or triangular),
+// threads place keys of disjoint slot ranges in parallel.
+// Must: keys are distinct and absent from table, as for insert.
+// Returns false and inserts nothing if fails to allocate.
+bool StremHashTable_insert_bulk(
+	StremHashTable* ht, void const* keys, void const* values, size_t count, size_t threads
+);
 // Removes the pair and returns ptr to associated value (NULL if no key found).
-// Value pointer is valid until any further action with the table.
+// Value pointer is valid until the next insert or remove.
 void* StremHashTable_remove(StremHashTable* ht, void const* key);
+// Erases every pair for which pred(key, value, ctx) is true in one pass over slots,
+// their value slots are reused by further inserts. Robin hood tables shift kept keys back
+// in the same pass, others leave dead slots, purged in place if they outnumber live keys.
+// Finishes incremental resize.
+// Must: table isn't a snapshot view; pred doesn't modify table.
+// Returns number of pairs erased.
+size_t StremHashTable_erase_if(StremHashTable* ht, StremPairPredicate pred, void* ctx);
 // Returns pointer to associated value (NULL if no key found)
 void* StremHashTable_at(StremHashTable* ht, void const* key);
-// Resizes and rehashes key vector
+// Same with hash computed by caller, must be as for upsert_hashed
+void* StremHashTable_at_hashed(StremHashTable* ht, void const* key, size_t hash);
+// Looks up count keys stored contiguously, writing pointer to associated value
+// (NULL if no key found) for each of them to values_out.
+// Hashes and prefetches home slots of a chunk of keys before probing any of them.
+void StremHashTable_at_batch(
+	StremHashTable* ht, void const* keys, size_t count, void** values_out
+);
+// Walks all slots, so costs as much as a resize without allocating.
+// Counters are reported as they are, they're never reset.
+StremHashStats StremHashTable_stats(StremHashTable* ht);
+// Resizes and rehashes key vector at once, even with STREM_HT_INCREMENTAL
+// Must: newcap is a power of two with STREM_INDEX_MASK
 void StremHashTable_resize(StremHashTable* ht, size_t newcap);
+// Rehashes keys in place at the same capacity, turning STREM_HT_DEAD slots empty.
+// Allocates nothing, finishes incremental resize first.
+// Insert calls it instead of growing when most of saturation is dead slots
+// (STREM_HT_INCREMENTAL tables migrate to arrays of the same capacity instead).
+void StremHashTable_purge(StremHashTable* ht);
 
 #endif // STREM_HT_H_
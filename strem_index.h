@@ -0,0 +1,96 @@
+#ifndef STREM_INDEX_H_
+#define STREM_INDEX_H_
+#include <stdint.h>
+#include "strem_common.h"
+
+// Stride of STREM_SEQ_GAP over single slots
+#define STREM_PROBE_GAP 5
+
+// How hash is reduced to home slot index
+typedef enum {
+	// hash % cap, any capacity
+	STREM_INDEX_MODULO = 0,
+	// Power-of-two capacity, hash is mixed by a finalizer and masked.
+	// Tolerates weak hash functions.
+	STREM_INDEX_MASK,
+	// Lemire's multiply-shift: (hash * cap) >> 64, any capacity.
+	// Uses high bits of hash, so they must be well mixed.
+	STREM_INDEX_FASTRANGE,
+} StremIndexPolicy;
+
+// Which slots are visited after home one
+typedef enum {
+	// Slots STREM_PROBE_GAP apart (groups STREM_GROUP_WIDTH apart in group modes)
+	STREM_SEQ_GAP = 0,
+	// Adjacent slots (adjacent groups in group modes)
+	STREM_SEQ_LINEAR,
+	// i-th probe steps i slots (groups) further, visits every slot.
+	// Must: STREM_INDEX_MASK
+	STREM_SEQ_TRIANGULAR,
+} StremProbeSequence;
+
+// murmur3 64-bit finalizer
+static inline size_t StremIndex_mix(size_t hash) {
+	uint64_t h = (uint64_t)hash;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+static inline size_t StremIndex_home(size_t hash, size_t cap, int policy) {
+	switch(policy) {
+	case STREM_INDEX_MASK:
+		return StremIndex_mix(hash) & (cap - 1);
+	case STREM_INDEX_FASTRANGE:
+#if defined(__SIZEOF_INT128__)
+		return (size_t)(((unsigned __int128)(uint64_t)hash * cap) >> 64);
+#else
+		return (size_t)(((uint64_t)(uint32_t)hash * (uint64_t)cap) >> 32);
+#endif
+	default:
+		return hash % cap;
+	}
+}
+
+// Returns index of probe-th position after index (probe counts from 1).
+// stride is 1 for single slots and STREM_GROUP_WIDTH for groups.
+// Doesn't divide: masks power-of-two capacity, subtracts otherwise.
+static inline size_t StremIndex_next(
+	size_t index, size_t probe, size_t cap, int policy, int seq, size_t stride
+) {
+	size_t step = stride;
+	if(seq == STREM_SEQ_TRIANGULAR) {
+		step *= probe;
+	} else if(seq == STREM_SEQ_GAP && stride == 1) {
+		step = STREM_PROBE_GAP;
+	}
+
+	index += step;
+	if(policy == STREM_INDEX_MASK) {
+		return index & (cap - 1);
+	}
+	while(index >= cap) {
+		index -= cap;
+	}
+	return index;
+}
+
+static inline bool StremIndex_is_pow2(size_t cap) {
+	return cap != 0 && (cap & (cap - 1)) == 0;
+}
+
+// Tells if policy and seq are known and fit cap, as constructors make sure they do.
+// For data which isn't built by containers themselves, e.g. snapshots.
+static inline bool StremIndex_valid(size_t cap, uint64_t policy, uint64_t seq) {
+	if(policy > STREM_INDEX_FASTRANGE || seq > STREM_SEQ_TRIANGULAR) {
+		return false;
+	} else if(policy == STREM_INDEX_MASK || seq == STREM_SEQ_TRIANGULAR) {
+		return policy == STREM_INDEX_MASK && StremIndex_is_pow2(cap);
+	}
+	return true;
+}
+
+#endif // STREM_INDEX_H_
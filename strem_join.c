@@ -0,0 +1,324 @@
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "strem_join.h"
+#include "strem_index.h"
+
+// partitions are never more, so a single scatter pass keeps its write targets in TLB
+#define MAX_PART_BITS 10
+// rows scattered by one thread are never fewer, smaller inputs use less threads
+#define MIN_THREAD_ROWS 4096
+// threads are never more, their arguments are on stack
+#define MAX_THREADS 64
+
+// Row copied to its partition: row number, hash, key, value.
+// Hash is computed once, then reused by scatter and by table of the partition.
+#define TUPLESIZE(job) ((2 * sizeof(size_t) + (job).key_size + (job).value_size + sizeof(size_t) - 1) \
+	/ sizeof(size_t) * sizeof(size_t))
+#define TUPLE_KEY (2 * sizeof(size_t))
+
+typedef struct {
+	char const* keys;
+	char const* values; /* NULL when probing */
+	size_t count;
+	size_t key_size;
+	size_t value_size;
+	StremHashFunction func; /* NULL for built-in hash of key_size bytes */
+	unsigned int part_bits;
+	size_t threads;
+	size_t* hashes; /* of every row, computed by count pass */
+	/* rows of every partition met by every thread (thread-major),
+	 * then tuple index where thread writes the next row of partition */
+	size_t* cursors;
+	size_t* part_begin; /* part_count + 1 tuple indices */
+	char* tuples; /* count tuples grouped by partition */
+} Partitioning;
+
+typedef struct {
+	Partitioning* job;
+	size_t thread;
+	bool scatter; /* rows are counted at first pass, copied at second one */
+} PartitionStep;
+
+// Partitions are taken by threads one by one, so skewed ones don't stall the rest
+typedef struct {
+	StremPartitionedTable* pt;
+	Partitioning* job;
+	size_t* next_part; /* shared by all threads */
+	size_t thread;
+	StremCmpFunction cmp_func; /* build only */
+	StremMergeFunction merge; /* build only */
+	StremJoinEmit emit; /* probe only */
+	void* ctx;
+	bool ok;
+} PartWork;
+
+// Same hash as tables of partitions compute for key
+static size_t hash_key(StremHashFunction func, void const* key, size_t key_size) {
+	return func != NULL ? func(key) : StremHash_bytes(key, key_size);
+}
+
+static size_t part_of(size_t hash, unsigned int part_bits) {
+	return part_bits != 0 ? StremIndex_mix(hash) >> (sizeof(size_t) * 8 - part_bits) : 0;
+}
+
+static unsigned int choose_part_bits(size_t count, size_t threads) {
+	/* a few partitions per thread even for small inputs, to balance them */
+	size_t parts = count / STREM_JOIN_PARTITION_ROWS;
+	if(threads > 1 && parts < threads * 4) {
+		parts = threads * 4;
+	}
+
+	unsigned int bits = 0;
+	while(bits < MAX_PART_BITS && ((size_t)1 << bits) < parts) {
+		bits++;
+	}
+	return bits;
+}
+
+static size_t clamp_threads(size_t threads) {
+	return threads == 0 ? 1 : threads < MAX_THREADS ? threads : MAX_THREADS;
+}
+
+// Runs work on args[0..threads), which are arg_size bytes apart.
+// Work of threads which fail to start is done by the calling one.
+static void run_threads(void* (*work)(void*), void* args, size_t arg_size, size_t threads) {
+	pthread_t ids[threads];
+	bool started[threads];
+
+	for(size_t t = 0; t < threads; t++) {
+		started[t] = t != 0 && pthread_create(&ids[t], NULL, work, (char*)args + t*arg_size) == 0;
+	}
+	for(size_t t = 0; t < threads; t++) {
+		if(started[t]) {
+			pthread_join(ids[t], NULL);
+		} else {
+			work((char*)args + t*arg_size);
+		}
+	}
+}
+
+static void* partition_step(void* arg) {
+	PartitionStep* const step = arg;
+	Partitioning* const job = step->job;
+	const size_t part_count = (size_t)1 << job->part_bits;
+	const size_t tuple_size = TUPLESIZE(*job);
+	size_t* const cursors = job->cursors + step->thread * part_count;
+	const size_t rows_per_thread = (job->count + job->threads - 1) / job->threads;
+	const size_t begin = step->thread * rows_per_thread;
+	const size_t end = begin + rows_per_thread < job->count ? begin + rows_per_thread : job->count;
+
+	for(size_t i = begin; i < end; i++) {
+		char const* const key = job->keys + i*job->key_size;
+
+		if(!step->scatter) {
+			job->hashes[i] = hash_key(job->func, key, job->key_size);
+			cursors[part_of(job->hashes[i], job->part_bits)]++;
+			continue;
+		}
+		char* const tuple = job->tuples + tuple_size * cursors[part_of(job->hashes[i], job->part_bits)]++;
+		memcpy(tuple, &i, sizeof(size_t));
+		memcpy(tuple + sizeof(size_t), &job->hashes[i], sizeof(size_t));
+		memcpy(tuple + TUPLE_KEY, key, job->key_size);
+		if(job->values != NULL) {
+			memcpy(tuple + TUPLE_KEY + job->key_size, job->values + i*job->value_size, job->value_size);
+		}
+	}
+	return NULL;
+}
+
+static void partitioning_free(Partitioning* job) {
+	free(job->hashes);
+	free(job->cursors);
+	free(job->part_begin);
+	free(job->tuples);
+}
+
+// Copies rows to tuples grouped by partition: every thread counts rows of its range,
+// so it gets its own place in every partition and scatters rows there.
+// Returns false if fails to allocate.
+static bool partition(Partitioning* job, size_t threads) {
+	const size_t part_count = (size_t)1 << job->part_bits;
+	const size_t max_threads = job->count / MIN_THREAD_ROWS;
+
+	job->threads = threads < max_threads ? threads : (max_threads != 0 ? max_threads : 1);
+	job->cursors = calloc(job->threads * part_count, sizeof(size_t));
+	job->part_begin = malloc((part_count + 1) * sizeof(size_t));
+	job->tuples = malloc((job->count != 0 ? job->count : 1) * TUPLESIZE(*job));
+	job->hashes = malloc((job->count != 0 ? job->count : 1) * sizeof(size_t));
+	if(job->cursors == NULL || job->part_begin == NULL || job->tuples == NULL || job->hashes == NULL) {
+		partitioning_free(job);
+		return false;
+	}
+
+	PartitionStep steps[job->threads];
+	for(size_t t = 0; t < job->threads; t++) {
+		steps[t] = (PartitionStep){ job, t, false };
+	}
+	run_threads(partition_step, steps, sizeof(PartitionStep), job->threads);
+
+	/* counts become offsets: partitions go one by one, threads' parts inside them in order */
+	size_t offset = 0;
+	for(size_t p = 0; p < part_count; p++) {
+		job->part_begin[p] = offset;
+		for(size_t t = 0; t < job->threads; t++) {
+			const size_t rows = job->cursors[t*part_count + p];
+			job->cursors[t*part_count + p] = offset;
+			offset += rows;
+		}
+	}
+	job->part_begin[part_count] = offset;
+
+	for(size_t t = 0; t < job->threads; t++) {
+		steps[t].scatter = true;
+	}
+	run_threads(partition_step, steps, sizeof(PartitionStep), job->threads);
+	free(job->hashes);
+	job->hashes = NULL;
+	return true;
+}
+
+static void* build_parts(void* arg) {
+	PartWork* const work = arg;
+	StremPartitionedTable* const pt = work->pt;
+	Partitioning* const job = work->job;
+	const size_t tuple_size = TUPLESIZE(*job);
+
+	work->ok = true;
+	for(size_t p; (p = __atomic_fetch_add(work->next_part, 1, __ATOMIC_RELAXED)) < pt->part_count;) {
+		StremHashTable* const ht = &pt->parts[p];
+		*ht = StremHashTable_construct_policy(
+			pt->key_size, pt->value_size, pt->func, work->cmp_func,
+			STREM_HT_GROUP, STREM_INDEX_MASK, STREM_SEQ_LINEAR
+		);
+		if(ht->keys.content == NULL) {
+			work->ok = false;
+			return NULL;
+		}
+
+		for(size_t i = job->part_begin[p]; i < job->part_begin[p + 1]; i++) {
+			char const* const tuple = job->tuples + tuple_size*i;
+			char const* const key = tuple + TUPLE_KEY;
+			size_t hash;
+			memcpy(&hash, tuple + sizeof(size_t), sizeof(size_t));
+			if(StremHashTable_upsert_hashed(ht, key, hash, key + pt->key_size, work->merge) == NULL) {
+				work->ok = false;
+				return NULL;
+			}
+		}
+	}
+	return NULL;
+}
+
+static void* probe_parts(void* arg) {
+	PartWork* const work = arg;
+	StremPartitionedTable* const pt = work->pt;
+	Partitioning* const job = work->job;
+	const size_t tuple_size = TUPLESIZE(*job);
+
+	for(size_t p; (p = __atomic_fetch_add(work->next_part, 1, __ATOMIC_RELAXED)) < pt->part_count;) {
+		for(size_t i = job->part_begin[p]; i < job->part_begin[p + 1]; i++) {
+			char const* const tuple = job->tuples + tuple_size*i;
+			size_t hash;
+			memcpy(&hash, tuple + sizeof(size_t), sizeof(size_t));
+			void* const value = StremHashTable_at_hashed(&pt->parts[p], tuple + TUPLE_KEY, hash);
+			if(value != NULL) {
+				size_t row;
+				memcpy(&row, tuple, sizeof(size_t));
+				work->emit(work->ctx, work->thread, row, value);
+			}
+		}
+	}
+	return NULL;
+}
+
+bool StremPartitionedTable_group_by(
+	StremPartitionedTable* pt,
+	void const* keys,
+	void const* values,
+	size_t count,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremMergeFunction merge,
+	size_t threads
+) {
+	threads = clamp_threads(threads);
+	func = func != NULL ? func : StremHash_for_size(key_size);
+	const unsigned int part_bits = choose_part_bits(count, threads);
+
+	*pt = (StremPartitionedTable){
+		calloc((size_t)1 << part_bits, sizeof(StremHashTable)),
+		(size_t)1 << part_bits,
+		part_bits,
+		key_size,
+		value_size,
+		func
+	};
+	if(pt->parts == NULL) {
+		return false;
+	}
+
+	Partitioning job = { keys, values, count, key_size, value_size, func, part_bits, 0, NULL, NULL, NULL, NULL };
+	if(!partition(&job, threads)) {
+		StremPartitionedTable_free(pt);
+		return false;
+	}
+
+	size_t next_part = 0;
+	PartWork works[threads];
+	for(size_t t = 0; t < threads; t++) {
+		works[t] = (PartWork){ pt, &job, &next_part, t, cmp_func, merge, NULL, NULL, true };
+	}
+	run_threads(build_parts, works, sizeof(PartWork), threads);
+	partitioning_free(&job);
+
+	for(size_t t = 0; t < threads; t++) {
+		if(!works[t].ok) {
+			StremPartitionedTable_free(pt);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool StremPartitionedTable_join(
+	StremPartitionedTable* pt,
+	void const* keys,
+	size_t count,
+	StremJoinEmit emit,
+	void* ctx,
+	size_t threads
+) {
+	threads = clamp_threads(threads);
+	Partitioning job = {
+		keys, NULL, count, pt->key_size, 0, pt->func, pt->part_bits, 0, NULL, NULL, NULL, NULL
+	};
+	if(!partition(&job, threads)) {
+		return false;
+	}
+
+	size_t next_part = 0;
+	PartWork works[threads];
+	for(size_t t = 0; t < threads; t++) {
+		works[t] = (PartWork){ pt, &job, &next_part, t, NULL, NULL, emit, ctx, true };
+	}
+	run_threads(probe_parts, works, sizeof(PartWork), threads);
+	partitioning_free(&job);
+	return true;
+}
+
+void* StremPartitionedTable_at(StremPartitionedTable* pt, void const* key) {
+	const size_t hash = hash_key(pt->func, key, pt->key_size);
+	return StremHashTable_at_hashed(&pt->parts[part_of(hash, pt->part_bits)], key, hash);
+}
+
+void StremPartitionedTable_free(StremPartitionedTable* pt) {
+	for(size_t p = 0; pt->parts != NULL && p < pt->part_count; p++) {
+		StremHashTable_free(&pt->parts[p]);
+	}
+	free(pt->parts);
+	pt->parts = NULL;
+	pt->part_count = 0;
+}
@@ -0,0 +1,65 @@
+#ifndef STREM_JOIN_H_
+#define STREM_JOIN_H_
+#include "strem_common.h"
+#include "strem_ht.h"
+
+// Rows per partition aimed at, so that its table stays in cache while it's built or probed
+#ifndef STREM_JOIN_PARTITION_ROWS
+#define STREM_JOIN_PARTITION_ROWS 4096
+#endif
+
+// Called for every probe row whose key is in table: row is its number in probe keys,
+// value points inside table. thread (< threads) tells which thread calls,
+// so results may be collected per thread without locking.
+typedef void(*StremJoinEmit)(void* ctx, size_t thread, size_t row, void* value);
+
+// Set of tables, each holding keys whose mixed hash has the same top bits.
+// Rows are radix-partitioned by these bits first, then every partition is built
+// or probed by one thread, so no table is ever written by two threads.
+typedef struct {
+	/* private: */
+	StremHashTable* parts;
+	size_t part_count; /* power of two */
+	unsigned int part_bits;
+	size_t key_size;
+	size_t value_size;
+	StremHashFunction func;
+} StremPartitionedTable;
+
+// Groups count rows, whose keys and values are stored contiguously in two arrays.
+// Values of equal keys are merged by merge(existing, value), the last one is kept if merge == NULL.
+// Every key is hashed once, its hash picks partition and is reused by table.
+// NULL func or cmp_func is replaced by built-in kernel for key_size (see strem_hash.h).
+// threads partition rows and build tables (threads == 0 is the same as 1, at most 64 are used).
+// Returns false if fails to allocate, pt holds nothing then.
+bool StremPartitionedTable_group_by(
+	StremPartitionedTable* pt,
+	void const* keys,
+	void const* values,
+	size_t count,
+	size_t key_size,
+	size_t value_size,
+	StremHashFunction func,
+	StremCmpFunction cmp_func,
+	StremMergeFunction merge,
+	size_t threads
+);
+
+// Hash join: partitions count contiguous probe keys like pt is partitioned,
+// then threads probe partitions, calling emit for every key found.
+// Returns false if fails to allocate, emit isn't called then.
+bool StremPartitionedTable_join(
+	StremPartitionedTable* pt,
+	void const* keys,
+	size_t count,
+	StremJoinEmit emit,
+	void* ctx,
+	size_t threads
+);
+
+// Returns pointer to value associated with key (NULL if no key found)
+void* StremPartitionedTable_at(StremPartitionedTable* pt, void const* key);
+
+void StremPartitionedTable_free(StremPartitionedTable* pt);
+
+#endif // STREM_JOIN_H_
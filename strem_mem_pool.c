@@ -1,4 +1,5 @@
 #include <stddef.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
 #include "strem_mem_pool.h"
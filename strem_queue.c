@@ -2,8 +2,14 @@
 #include <string.h>
 
 StremQueue StremQueue_construct(size_t elem_size, size_t capacity) {
+    return StremQueue_construct_with(elem_size, capacity, NULL);
+}
+
+StremQueue StremQueue_construct_with(
+    size_t elem_size, size_t capacity, StremAllocator const* allocator
+) {
     StremQueue q = {0};
-    q.v = StremVector_construct(elem_size, capacity ? capacity : 1);
+    q.v = StremVector_construct_with(elem_size, capacity ? capacity : 1, allocator);
     return q;
 }
 
@@ -17,7 +23,7 @@ void StremQueue_reserve(StremQueue* q, size_t capacity) {
     }
 
     // TODO: newbuf may be null
-    char* newbuf = calloc(capacity, q->v.elem_size);
+    char* newbuf = StremAllocator_calloc(q->v.allocator, capacity, q->v.elem_size);
     char* appendptr = newbuf;
 
     if(q->v.size != 0) {
@@ -39,7 +45,7 @@ void StremQueue_reserve(StremQueue* q, size_t capacity) {
         }
     }
 
-    free(q->v.content);
+    StremAllocator_free(q->v.allocator, q->v.content);
     q->v.content = (void*)newbuf;
     q->v.capacity_elems = capacity;
     q->rear = 0;
@@ -9,6 +9,10 @@ typedef struct {
 } StremQueue;
 
 StremQueue StremQueue_construct(size_t elem_size, size_t capacity);
+// Same, allocating from allocator (NULL for malloc)
+StremQueue StremQueue_construct_with(
+    size_t elem_size, size_t capacity, StremAllocator const* allocator
+);
 void StremQueue_free(StremQueue* q);
 void StremQueue_reserve(StremQueue* q, size_t capacity);
 void* StremQueue_insert(StremQueue* q, void const* elem);
@@ -23,8 +23,14 @@ static void turn_memblock_in_free_chain(
 }
 
 void* StremSegrLine_alloc(size_t elem_size, size_t elem_count) {
+	return StremSegrLine_alloc_with(NULL, elem_size, elem_count);
+}
+
+void* StremSegrLine_alloc_with(
+	StremAllocator const* allocator, size_t elem_size, size_t elem_count
+) {
 	const size_t total_byte_size = elem_size*elem_count;
-	char* line_content = malloc(total_byte_size);
+	char* line_content = StremAllocator_alloc(allocator, total_byte_size);
 
 	if(line_content == NULL) {
 		return NULL;
@@ -1,6 +1,8 @@
 #ifndef STREM_SEGR_LINE_H_
 #define STREM_SEGR_LINE_H_
 #include <stdbool.h>
+#include <stddef.h>
+#include "strem_alloc.h"
 
 struct StremSegrLine_FreeNode {
 	struct StremSegrLine_FreeNode* next;
@@ -12,6 +14,10 @@ typedef struct {
 } StremSegrLine;
 
 void* StremSegrLine_alloc(size_t elem_size, size_t elem_count);
+// Same, allocating from allocator (NULL for malloc)
+void* StremSegrLine_alloc_with(
+	StremAllocator const* allocator, size_t elem_size, size_t elem_count
+);
 void* StremSegrLine_emplace(void* at, size_t elem_size, size_t elem_count);
 StremSegrLine_FreeNode* StremSegrLine_grow_alloced(
 	StremSegrLine* line, 
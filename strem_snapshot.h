@@ -0,0 +1,73 @@
+#ifndef STREM_SNAPSHOT_H_
+#define STREM_SNAPSHOT_H_
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "strem_common.h"
+
+// Snapshot is a file holding slot arrays of a set or table as they are in memory,
+// so mapping it is enough to look keys up, nothing is rehashed.
+// Values are stored by offset from the values section, keys are stored with their hashes.
+// Sections start at STREM_SNAPSHOT_ALIGN offsets, so a mapped snapshot keeps slots aligned.
+// Format depends on slot layout, so it's read only by builds of the same ABI.
+
+#define STREM_SNAPSHOT_VERSION 1
+#define STREM_SNAPSHOT_ALIGN 64
+#define STREM_SNAPSHOT_HS_MAGIC "STREMHS"
+#define STREM_SNAPSHOT_HT_MAGIC "STREMHT"
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_header_size; /* sizeof(StremHSKey) or sizeof(StremHTKey) */
+	uint64_t hash_seed; /* whatever seed hash function used, checked by view */
+	uint64_t key_size;
+	uint64_t value_size; /* 0 for sets */
+	uint64_t cap;
+	uint64_t size;
+	uint32_t mode;
+	uint32_t index_policy;
+	uint32_t probe_seq;
+	uint32_t reserved;
+	/* from the beginning of snapshot, 0 if there's no such section: */
+	uint64_t keys_offset;
+	uint64_t ctrl_offset;
+	uint64_t values_offset;
+	uint64_t total_size;
+} StremSnapshotHeader;
+
+static inline uint64_t StremSnapshot_align(uint64_t offset) {
+	return (offset + STREM_SNAPSHOT_ALIGN - 1) / STREM_SNAPSHOT_ALIGN * STREM_SNAPSHOT_ALIGN;
+}
+
+// Writes zeros up to offset. Returns false on write error.
+static inline bool StremSnapshot_pad(FILE* file, uint64_t written, uint64_t offset) {
+	static const char zeros[STREM_SNAPSHOT_ALIGN] = { 0 };
+	return fwrite(zeros, 1, (size_t)(offset - written), file) == offset - written;
+}
+
+// Checks that buf holds a whole snapshot of expected kind
+static inline bool StremSnapshot_valid(
+	StremSnapshotHeader const* header,
+	size_t buf_size,
+	char const* magic,
+	uint32_t slot_header_size,
+	uint64_t hash_seed,
+	uint64_t key_size,
+	uint64_t value_size
+) {
+	return buf_size >= sizeof(StremSnapshotHeader)
+		&& memcmp(header->magic, magic, sizeof(header->magic)) == 0
+		&& header->version == STREM_SNAPSHOT_VERSION
+		&& header->slot_header_size == slot_header_size
+		&& header->hash_seed == hash_seed
+		&& header->key_size == key_size
+		&& header->value_size == value_size
+		&& header->cap != 0
+		&& header->total_size <= buf_size
+		&& header->keys_offset + header->cap * (slot_header_size + key_size) <= header->total_size
+		&& header->ctrl_offset <= header->total_size
+		&& header->values_offset <= header->total_size;
+}
+
+#endif // STREM_SNAPSHOT_H_
@@ -0,0 +1,47 @@
+#ifndef STREM_STATS_H_
+#define STREM_STATS_H_
+#include <stdint.h>
+#include "strem_common.h"
+
+// Occupancy report of hash set or table, gathered by walking all slots.
+// Probe length of a key is the number of probes past its home slot
+// (groups past home group in group modes).
+
+// Keys with probe length i are counted in probe_hist[i], the last bucket counts longer ones too
+#define STREM_STATS_HIST_SIZE 16
+
+// Counts of key lookups, updated only if STREM_HASH_COUNTERS is defined
+// when building containers (plain increments, so approximate when probed by many threads)
+typedef struct {
+	uint64_t lookups; /* by at, at_batch, remove and find_or_insert of tables */
+	uint64_t probes; /* slots (groups in group modes) visited by them */
+	uint64_t cmp_calls;
+} StremHashCounters;
+
+typedef struct {
+	size_t size;
+	size_t cap; /* both generations while resizing incrementally */
+	size_t tombstones; /* dead slots */
+	double avg_probe;
+	size_t max_probe;
+	size_t probe_hist[STREM_STATS_HIST_SIZE];
+	size_t resizes; /* growths since construction */
+	size_t key_bytes; /* slot arrays and control bytes */
+	size_t value_bytes; /* values of taken slots, 0 for sets */
+	size_t dead_value_bytes; /* value slots allocated but holding no value, 0 for sets */
+	StremHashCounters counters;
+} StremHashStats;
+
+static inline void StremHashStats_add_probe(StremHashStats* stats, size_t probe) {
+	stats->probe_hist[probe < STREM_STATS_HIST_SIZE ? probe : STREM_STATS_HIST_SIZE - 1]++;
+	stats->max_probe = probe > stats->max_probe ? probe : stats->max_probe;
+	stats->avg_probe += (double)probe;
+}
+
+#ifdef STREM_HASH_COUNTERS
+#define STREM_COUNT(container, counter, n) ((container)->counters.counter += (n))
+#else
+#define STREM_COUNT(container, counter, n) ((void)0)
+#endif
+
+#endif // STREM_STATS_H_
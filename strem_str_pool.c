@@ -0,0 +1,209 @@
+#include <string.h>
+#include <assert.h>
+#include "strem_str_pool.h"
+#include "strem_hash.h"
+
+#define DEFAULT_POOL_CAP 64
+#define DEFAULT_CHUNK_SIZE 4096
+// chunks double up to it, so unused tail of the last chunk stays bounded
+#define MAX_CHUNK_SIZE ((size_t)1 << 24)
+// lines hashed and looked up at once by intern_lines
+#define LINES_CHUNK 32
+
+static size_t key_hash(void const* key) {
+	StremStrKey const* const str_key = key;
+	return StremHash_bytes(str_key->bytes, str_key->length);
+}
+
+static bool keys_equal(void const* a, void const* b) {
+	StremStrKey const* const x = a;
+	StremStrKey const* const y = b;
+
+	return x->length == y->length
+		&& memcmp(x->prefix, y->prefix, STREM_STR_PREFIX) == 0
+		&& (x->length <= STREM_STR_PREFIX
+			|| memcmp(x->bytes + STREM_STR_PREFIX, y->bytes + STREM_STR_PREFIX, x->length - STREM_STR_PREFIX) == 0);
+}
+
+static StremStrKey make_key(char const* bytes, size_t length) {
+	StremStrKey key = { 0 };
+
+	key.bytes = bytes;
+	key.length = (uint32_t)length;
+	memcpy(key.prefix, bytes, length < STREM_STR_PREFIX ? length : STREM_STR_PREFIX);
+	return key;
+}
+
+// Bumps size bytes from the last chunk, allocating a new one if they don't fit
+static char* arena_alloc(StremStrPool* pool, size_t size) {
+	if(pool->chunk_cap - pool->chunk_used < size) {
+		size_t cap = pool->chunk_cap == 0 ? DEFAULT_CHUNK_SIZE
+			: pool->chunk_cap < MAX_CHUNK_SIZE ? pool->chunk_cap * 2 : pool->chunk_cap;
+		while(cap < size) {
+			cap *= 2;
+		}
+
+		char* const chunk = StremAllocator_alloc(pool->allocator, cap);
+		if(chunk == NULL) {
+			return NULL;
+		}
+		if(StremVector_push(&pool->chunks, &chunk, 1) == NULL) {
+			StremAllocator_free(pool->allocator, chunk);
+			return NULL;
+		}
+		pool->chunk = chunk;
+		pool->chunk_used = 0;
+		pool->chunk_cap = cap;
+	}
+
+	char* const bytes = pool->chunk + pool->chunk_used;
+	pool->chunk_used += size;
+	return bytes;
+}
+
+// Copies bytes of just inserted slot to arena and points it to them
+static uint32_t add(StremStrPool* pool, StremStrKey* slot) {
+	if(pool->entries.size >= STREM_STR_NONE) {
+		return STREM_STR_NONE;
+	}
+
+	char* const bytes = arena_alloc(pool, (size_t)slot->length + 1);
+	if(bytes == NULL) {
+		return STREM_STR_NONE;
+	}
+	memcpy(bytes, slot->bytes, slot->length);
+	bytes[slot->length] = '\0';
+
+	const StremStrEntry entry = { bytes, slot->length };
+	if(StremVector_push(&pool->entries, &entry, 1) == NULL) {
+		return STREM_STR_NONE;
+	}
+	slot->bytes = bytes;
+	slot->id = (uint32_t)(pool->entries.size - 1);
+	return slot->id;
+}
+
+// Finds or inserts key with a single probe of the set
+static uint32_t intern_key(StremStrPool* pool, StremStrKey const* key, size_t hash) {
+	bool inserted = false;
+	StremStrKey* const slot = StremHashSet_find_or_insert_hashed(&pool->set, key, hash, &inserted);
+
+	if(slot == NULL) {
+		return STREM_STR_NONE;
+	} else if(!inserted) {
+		return slot->id;
+	}
+
+	const uint32_t id = add(pool, slot);
+	if(id == STREM_STR_NONE) {
+		/* slot still points to caller bytes, equal to key */
+		StremHashSet_remove(&pool->set, key);
+	}
+	return id;
+}
+
+StremStrPool StremStrPool_construct(void) {
+	return StremStrPool_construct_with(NULL);
+}
+
+StremStrPool StremStrPool_construct_with(StremAllocator const* allocator) {
+	StremStrPool pool = { 0 };
+
+	pool.allocator = allocator;
+	pool.set = StremHashSet_construct_with(
+		sizeof(StremStrKey), key_hash, keys_equal,
+		STREM_HS_GROUP, STREM_INDEX_MASK, STREM_SEQ_LINEAR, allocator
+	);
+	pool.entries = StremVector_construct_with(sizeof(StremStrEntry), DEFAULT_POOL_CAP, allocator);
+	pool.chunks = StremVector_construct_with(sizeof(char*), DEFAULT_POOL_CAP, allocator);
+
+	if(pool.set.keys == NULL || pool.entries.content == NULL || pool.chunks.content == NULL) {
+		StremStrPool_free(&pool);
+	}
+	return pool;
+}
+
+void StremStrPool_free(StremStrPool* pool) {
+	for(size_t i = 0; pool->chunks.content != NULL && i < pool->chunks.size; i++) {
+		StremAllocator_free(pool->allocator, StremVectorAt(pool->chunks, char*, i));
+	}
+	StremVector_free(&pool->chunks);
+	StremVector_free(&pool->entries);
+	StremHashSet_free(&pool->set);
+	pool->set.keys = NULL;
+	pool->chunk = NULL;
+	pool->chunk_used = 0;
+	pool->chunk_cap = 0;
+}
+
+uint32_t StremStrPool_intern(StremStrPool* pool, char const* bytes, size_t length) {
+	if(length >= UINT32_MAX) {
+		return STREM_STR_NONE;
+	}
+	const StremStrKey key = make_key(bytes, length);
+	return intern_key(pool, &key, StremHash_bytes(bytes, length));
+}
+
+uint32_t StremStrPool_find(StremStrPool* pool, char const* bytes, size_t length) {
+	if(length >= UINT32_MAX) {
+		return STREM_STR_NONE;
+	}
+	const StremStrKey key = make_key(bytes, length);
+	StremStrKey const* const found = StremHashSet_at(&pool->set, &key);
+	return found != NULL ? found->id : STREM_STR_NONE;
+}
+
+char const* StremStrPool_get(StremStrPool* pool, uint32_t id, size_t* length_out) {
+	assert(id < pool->entries.size && "No string with such id");
+	const StremStrEntry entry = StremVectorAt(pool->entries, StremStrEntry, id);
+
+	if(length_out != NULL) {
+		*length_out = entry.length;
+	}
+	return entry.bytes;
+}
+
+size_t StremStrPool_intern_lines(
+	StremStrPool* pool, char const* buf, size_t buf_size, uint32_t* ids_out
+) {
+	StremStrKey keys[LINES_CHUNK];
+	size_t hashes[LINES_CHUNK];
+	void* found[LINES_CHUNK];
+	uint32_t ids[LINES_CHUNK];
+	char const* at = buf;
+	char const* const end = buf + buf_size;
+	size_t lines = 0;
+
+	while(at < end) {
+		size_t count = 0;
+		for(; count < LINES_CHUNK && at < end; count++) {
+			char const* const newline = memchr(at, '\n', (size_t)(end - at));
+			const size_t length = (size_t)((newline != NULL ? newline : end) - at);
+			if(length >= UINT32_MAX) {
+				return lines;
+			}
+			keys[count] = make_key(at, length);
+			hashes[count] = StremHash_bytes(at, length);
+			at = newline != NULL ? newline + 1 : end;
+		}
+
+		/* ids are read before any insert, which may move found keys */
+		StremHashSet_at_batch_hashed(&pool->set, keys, hashes, count, found);
+		for(size_t i = 0; i < count; i++) {
+			ids[i] = found[i] != NULL ? ((StremStrKey const*)found[i])->id : STREM_STR_NONE;
+		}
+
+		/* a line new to the set may repeat within the batch, so misses find or insert */
+		for(size_t i = 0; i < count; i++) {
+			const uint32_t id = ids[i] != STREM_STR_NONE ? ids[i] : intern_key(pool, &keys[i], hashes[i]);
+			if(id == STREM_STR_NONE) {
+				return lines;
+			}
+			if(ids_out != NULL) {
+				ids_out[lines] = id;
+			}
+			lines++;
+		}
+	}
+	return lines;
+}
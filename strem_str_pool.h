@@ -0,0 +1,66 @@
+#ifndef STREM_STR_POOL_H_
+#define STREM_STR_POOL_H_
+#include <stdint.h>
+#include "strem_common.h"
+#include "strem_hs.h"
+
+// Bytes of string kept in set slot, compared before string itself is read
+#define STREM_STR_PREFIX 8
+// Id returned if string isn't (or can't be) interned
+#define STREM_STR_NONE UINT32_MAX
+
+// Key of the set: length and prefix are compared first, bytes only if they match.
+// Hash is kept only in the set slot, pool computes it once per string.
+typedef struct {
+	char const* bytes;
+	uint32_t length;
+	uint32_t id;
+	char prefix[STREM_STR_PREFIX]; /* zero padded */
+} StremStrKey;
+
+typedef struct {
+	char const* bytes;
+	size_t length;
+} StremStrEntry;
+
+// Interned strings, each stored once, NUL-terminated, in arena chunks which never move.
+// Ids are numbers of strings in order of interning.
+typedef struct {
+	/* private: */
+	StremHashSet set; /* StremStrKey */
+	StremVector /* StremStrEntry */ entries; /* by id */
+	StremVector /* char* */ chunks;
+	char* chunk; /* the last one, bytes are bumped from it */
+	size_t chunk_used;
+	size_t chunk_cap;
+	StremAllocator const* allocator; /* NULL for malloc */
+} StremStrPool;
+
+// If fails to allocate, pool.entries.content == NULL
+StremStrPool StremStrPool_construct(void);
+// Same, set and chunks are allocated from allocator (NULL for malloc)
+StremStrPool StremStrPool_construct_with(StremAllocator const* allocator);
+
+void StremStrPool_free(StremStrPool* pool);
+
+// Returns id of string equal to bytes[0, length), copying it to pool if there's none.
+// Returns STREM_STR_NONE if fails to allocate or there are UINT32_MAX strings already.
+uint32_t StremStrPool_intern(StremStrPool* pool, char const* bytes, size_t length);
+
+// Returns id of string equal to bytes[0, length), STREM_STR_NONE if it isn't interned
+uint32_t StremStrPool_find(StremStrPool* pool, char const* bytes, size_t length);
+
+// Returns NUL-terminated string of id, valid until pool is freed.
+// Writes its length to length_out unless it's NULL.
+// Must: id < pool.entries.size
+char const* StremStrPool_get(StremStrPool* pool, uint32_t id, size_t* length_out);
+
+// Interns every '\n'-terminated line of buf (the last one may end with buf),
+// writing their ids to ids_out unless it's NULL.
+// Lines are looked up in prefetched batches, only new ones are copied.
+// Returns number of lines interned, which is less than lines in buf if fails to allocate.
+size_t StremStrPool_intern_lines(
+	StremStrPool* pool, char const* buf, size_t buf_size, uint32_t* ids_out
+);
+
+#endif // STREM_STR_POOL_H_
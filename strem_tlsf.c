@@ -175,6 +175,7 @@ static void merge_free(StremTLSFBlock* const f, StremTLSFBlock* const s) {
 	assert(block_adjacent(f, s) && "can merge only adjacent");
 
 	block_set_size(f, block_size(f) + block_struct_size(s));
+	block_set_last(f, block_is_last(s));
 
 	if(!block_is_last(f)) {
 		block_chain(f);
@@ -301,7 +302,11 @@ static bool StremTLSF_find_block(
 	uint8_t* const sl
 ) {
 	assert(asize % STREM_TLSF_CONTENT_MINSIZE == 0 && "must align for flag storage");
-	mapping(asize, fl, sl);
+	// round up to the next class, so that any block of found class fits asize
+	const size_t search_size = asize >= ((size_t)1 << STREM_TLSF_SLI)
+		? asize + ((size_t)1 << (FLS(asize) - STREM_TLSF_SLI)) - 1
+		: asize;
+	mapping(search_size, fl, sl);
 
 	const uint32_t sfree_map = t->sbmap[*fl] & ((uint32_t)(-1) << *sl);
 
@@ -362,11 +367,15 @@ void* StremTLSF_alloc(StremTLSF* const t, const size_t asize) {
 	}
 
 	StremTLSFBlock* const block = t->blocks[fl][sl];
-	StremTLSFBlock* const next = split_free(block, rounded(asize, block_size(block)));
+	assert(block_size(block) >= asize && "found block must fit");
 	StremTLSF_remove_free(t, block, fl, sl);
 
-	mapping(block_size(next), &fl, &sl);
-	StremTLSF_insert(t, next, fl, sl);
+	const size_t bsize = rounded(asize, block_size(block));
+	if(bsize != block_size(block)) {
+		StremTLSFBlock* const next = split_free(block, bsize);
+		mapping(block_size(next), &fl, &sl);
+		StremTLSF_insert(t, next, fl, sl);
+	}
 
 	return block->content;
 }
@@ -430,17 +439,14 @@ void* StremTLSF_realloc(StremTLSF* const t, void* const content, const size_t as
 		|| !block_is_free(nextblock) 
 		|| asize > block_size(block) + block_struct_size(nextblock)
 	) {
-		char content_small_copy[STREM_TLSF_CONTENT_MINSIZE];
-		memcpy(content_small_copy, content, STREM_TLSF_CONTENT_MINSIZE);
-		StremTLSF_free(t, content);
-
+		/* block found after freeing may overlap content and be split inside it,
+		 * so content is copied before it's freed */
 		void* const ncontent = StremTLSF_alloc(t, asize);
-		memcpy(ncontent, content_small_copy, sizeof(content_small_copy));
-		memmove(
-			(char*)ncontent + sizeof(content_small_copy), 
-			(char*)content + sizeof(content_small_copy),
-			prevsize - sizeof(content_small_copy)
-		);
+		if(ncontent == NULL) {
+			return NULL;
+		}
+		memcpy(ncontent, content, prevsize);
+		StremTLSF_free(t, content);
 		return ncontent;
 	}
 
@@ -2,17 +2,26 @@
 #include <string.h>
 
 StremVector StremVector_construct(size_t elem_size, size_t capacity) {
+	return StremVector_construct_with(elem_size, capacity, NULL);
+}
+
+StremVector StremVector_construct_with(
+	size_t elem_size, size_t capacity, StremAllocator const* allocator
+) {
 	return (StremVector){ 
 		elem_size,
 		capacity,
 		0,
-		calloc(elem_size, capacity)
+		StremAllocator_calloc(allocator, elem_size, capacity),
+		allocator
 	};
 }
 
 bool StremVector_reserve(StremVector* vector, size_t capacity) {
 	if(vector->capacity_elems < capacity) {
-		void* newcontent = realloc(vector->content, capacity * vector->elem_size);
+		void* newcontent = StremAllocator_realloc(
+			vector->allocator, vector->content, capacity * vector->elem_size
+		);
 		if(newcontent == NULL) {
 			return false;
 		}
@@ -43,14 +52,14 @@ StremVector StremVector_copy(const StremVector* vector) {
 	StremVector newvec = *vector;
 
 	const size_t bytesize = vector->capacity_elems * vector->elem_size;
-	newvec.content = malloc(bytesize);
+	newvec.content = StremAllocator_alloc(vector->allocator, bytesize);
 	memcpy(newvec.content, vector->content, bytesize);
 
 	return newvec;
 }
 
 void StremVector_free(StremVector* vector) {
-	free(vector->content);
+	StremAllocator_free(vector->allocator, vector->content);
 	vector->content = NULL;
 	vector->size = 0;
 }
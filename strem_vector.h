@@ -2,17 +2,22 @@
 #define STREM_VECTOR_H_
 #include <stdbool.h>
 #include <stdlib.h>
-#include <stdbool.h>
+#include "strem_alloc.h"
 
 typedef struct {
 	size_t elem_size;
 	size_t capacity_elems;
 	size_t size;
 	void* content;
+	StremAllocator const* allocator; /* NULL for malloc */
 } StremVector;
 
 // If fail to allocate, returns vector with content == NULL
 StremVector StremVector_construct(size_t elem_size, size_t capacity);
+// Same, allocating from allocator (NULL for malloc)
+StremVector StremVector_construct_with(
+	size_t elem_size, size_t capacity, StremAllocator const* allocator
+);
 
 // Returns false if fail to reallocate, otherwise returns true
 bool StremVector_reserve(StremVector* vector, size_t capacity);
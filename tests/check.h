@@ -0,0 +1,15 @@
+#ifndef STREM_TESTS_CHECK_H_
+#define STREM_TESTS_CHECK_H_
+#include <stdio.h>
+#include <stdlib.h>
+
+// Unlike assert, stays with NDEBUG. Tested calls are made outside of it anyway,
+// so their results are checked and never compiled out.
+#define CHECK(cond) do { \
+	if(!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while(0)
+
+#endif // STREM_TESTS_CHECK_H_
@@ -0,0 +1,87 @@
+// Table and set sharing one arena keep every key across growth.
+// Build: cc -std=c11 -I.. test_alloc.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "strem_alloc.h"
+#include "check.h"
+
+#define ARENA_SIZE ((size_t)1 << 24)
+#define KEYS 20000
+
+static size_t arena[ARENA_SIZE / sizeof(size_t)];
+static uint64_t keys[KEYS];
+static bool live[KEYS];
+
+static void check_keys(StremHashTable* ht, StremHashSet* hs, size_t count) {
+	for(size_t i = 0; i < count; i++) {
+		uint64_t* const value = StremHashTable_at(ht, &keys[i]);
+		uint64_t* const key = StremHashSet_at(hs, &keys[i]);
+		CHECK((value != NULL) == live[i] && (value == NULL || *value == i));
+		CHECK((key != NULL) == live[i]);
+	}
+}
+
+// Inserts keys in random order, removing some, checks all of them after every growth.
+// Modulo index and gap probing make linear sets grow in place by realloc.
+static void churn(StremAllocator const* allocator, int mode, unsigned int seed) {
+	StremHashTable ht = StremHashTable_construct_with(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL,
+		(StremHTMode)mode, STREM_INDEX_MODULO, STREM_SEQ_GAP, allocator
+	);
+	StremHashSet hs = StremHashSet_construct_with(
+		sizeof(uint64_t), NULL, NULL, (StremHSMode)mode, STREM_INDEX_MODULO, STREM_SEQ_GAP, allocator
+	);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+
+	srand(seed);
+	for(size_t i = 0; i < KEYS; i++) {
+		keys[i] = ((uint64_t)rand() << 32) ^ (uint64_t)rand() ^ i;
+		live[i] = false;
+	}
+	for(size_t i = 0; i < KEYS; i++) {
+		const size_t ht_cap = ht.keys.capacity_elems;
+		const size_t hs_cap = hs.cap;
+		const uint64_t value = i;
+
+		uint64_t* const inserted_value = StremHashTable_insert(&ht, &keys[i], &value);
+		uint64_t* const inserted_key = StremHashSet_insert(&hs, &keys[i]);
+		CHECK(inserted_value != NULL && inserted_key != NULL);
+		live[i] = true;
+
+		if(rand() % 4 == 0) {
+			const size_t victim = (size_t)rand() % (i + 1);
+			if(live[victim]) {
+				void* const removed_value = StremHashTable_remove(&ht, &keys[victim]);
+				void* const removed_key = StremHashSet_remove(&hs, &keys[victim]);
+				CHECK(removed_value != NULL && removed_key != NULL);
+				live[victim] = false;
+			}
+		}
+		if(ht.keys.capacity_elems != ht_cap || hs.cap != hs_cap) {
+			check_keys(&ht, &hs, i + 1);
+		}
+	}
+	check_keys(&ht, &hs, KEYS);
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+}
+
+int main(void) {
+	for(unsigned int seed = 0; seed < 8; seed++) {
+		for(int mode = STREM_HS_LINEAR; mode <= STREM_HS_ROBIN_HOOD; mode++) {
+			StremMemPool pool = StremMemPool_emplace_pool(arena, ARENA_SIZE);
+			const StremAllocator pool_allocator = StremAllocator_mem_pool(&pool);
+			churn(&pool_allocator, mode, seed);
+
+			StremTLSF* const tlsf = StremTLSF_emplace(arena, ARENA_SIZE);
+			CHECK(tlsf != NULL);
+			const StremAllocator tlsf_allocator = StremAllocator_tlsf(tlsf);
+			churn(&tlsf_allocator, mode, seed);
+		}
+	}
+	puts("test_alloc: ok");
+	return 0;
+}
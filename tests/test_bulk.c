@@ -0,0 +1,91 @@
+// Bulk insert places every pair once, whether the table is filled by one thread
+// or by many (thread counts past the supported maximum are clamped).
+// Build: cc -std=c11 -I.. test_bulk.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "check.h"
+
+#define KEYS 300000
+#define PREFIX 1000
+
+static uint64_t keys[KEYS];
+static uint64_t values[KEYS];
+
+static void check_table(StremHashTable* ht) {
+	for(size_t i = 0; i < KEYS; i++) {
+		uint64_t* const value = StremHashTable_at(ht, &keys[i]);
+		CHECK(value != NULL && *value == values[i]);
+	}
+	for(uint64_t key = 1; key < 1000; key += 2) {
+		CHECK(StremHashTable_at(ht, &key) == NULL);
+	}
+	CHECK(StremHashTable_stats(ht).size == KEYS);
+}
+
+static void check_set(StremHashSet* hs) {
+	for(size_t i = 0; i < KEYS; i++) {
+		uint64_t* const key = StremHashSet_at(hs, &keys[i]);
+		CHECK(key != NULL && *key == keys[i]);
+	}
+	for(uint64_t key = 1; key < 1000; key += 2) {
+		CHECK(StremHashSet_at(hs, &key) == NULL);
+	}
+	CHECK(StremHashSet_stats(hs).size == KEYS);
+}
+
+static void run(
+	StremHTMode ht_mode, StremHSMode hs_mode, StremIndexPolicy index_policy,
+	StremProbeSequence probe_seq, size_t threads
+) {
+	StremHashTable ht = StremHashTable_construct_policy(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, ht_mode, index_policy, probe_seq
+	);
+	StremHashSet hs = StremHashSet_construct_policy(
+		sizeof(uint64_t), NULL, NULL, hs_mode, index_policy, probe_seq
+	);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+
+	/* pairs already in table are probed past, not overwritten */
+	for(size_t i = 0; i < PREFIX; i++) {
+		void* const inserted_value = StremHashTable_insert(&ht, &keys[i], &values[i]);
+		void* const inserted_key = StremHashSet_insert(&hs, &keys[i]);
+		CHECK(inserted_value != NULL && inserted_key != NULL);
+	}
+	const bool table_filled = StremHashTable_insert_bulk(
+		&ht, keys + PREFIX, values + PREFIX, KEYS - PREFIX, threads
+	);
+	const bool set_filled = StremHashSet_insert_bulk(&hs, keys + PREFIX, KEYS - PREFIX, threads);
+	CHECK(table_filled && set_filled);
+	check_table(&ht);
+	check_set(&hs);
+
+	/* empty batch changes nothing */
+	CHECK(StremHashTable_insert_bulk(&ht, keys, values, 0, threads));
+	CHECK(StremHashSet_insert_bulk(&hs, keys, 0, threads));
+	CHECK(StremHashTable_stats(&ht).size == KEYS && StremHashSet_stats(&hs).size == KEYS);
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+}
+
+int main(void) {
+	/* even keys, scattered so that home slots aren't in input order */
+	for(size_t i = 0; i < KEYS; i++) {
+		keys[i] = (uint64_t)i * 0x9E3779B97F4A7C16ull;
+		values[i] = (uint64_t)i;
+	}
+
+	static const size_t thread_counts[] = { 1, 4, 1000 };
+	for(size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+		const size_t threads = thread_counts[t];
+		run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_MASK, STREM_SEQ_LINEAR, threads);
+		run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_MODULO, STREM_SEQ_GAP, threads);
+		run(STREM_HT_GROUP, STREM_HS_GROUP, STREM_INDEX_FASTRANGE, STREM_SEQ_LINEAR, threads);
+		run(STREM_HT_GROUP, STREM_HS_GROUP, STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR, threads);
+		run(STREM_HT_ROBIN_HOOD, STREM_HS_ROBIN_HOOD, STREM_INDEX_MASK, STREM_SEQ_LINEAR, threads);
+	}
+	puts("test_bulk: ok");
+	return 0;
+}
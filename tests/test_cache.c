@@ -0,0 +1,153 @@
+// Cache evicts exactly what LRU and CLOCK policies pick: random gets, puts and removes
+// are replayed on a plain array model and both must agree on every entry and counter.
+// Build: cc -std=c11 -I.. test_cache.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_cache.h"
+#include "check.h"
+
+#define CAPACITY 64
+#define KEYS 200
+#define OPS 200000
+
+// Entries in list order: LRU from the most recent one, CLOCK from the hand
+typedef struct {
+	uint64_t key;
+	uint64_t value;
+	bool referenced;
+} Entry;
+
+static Entry ring[CAPACITY + 1];
+static size_t ring_size;
+static size_t evictions;
+
+static size_t find(uint64_t key) {
+	for(size_t i = 0; i < ring_size; i++) {
+		if(ring[i].key == key) {
+			return i;
+		}
+	}
+	return ring_size;
+}
+
+static Entry take(size_t i) {
+	const Entry entry = ring[i];
+	memmove(&ring[i], &ring[i + 1], (ring_size - i - 1) * sizeof(Entry));
+	ring_size--;
+	return entry;
+}
+
+static void push_front(Entry entry) {
+	memmove(&ring[1], &ring[0], ring_size * sizeof(Entry));
+	ring[0] = entry;
+	ring_size++;
+}
+
+static void push_back(Entry entry) {
+	ring[ring_size++] = entry;
+}
+
+static void model_touch(StremCacheMode mode, size_t i) {
+	if(mode == STREM_CACHE_CLOCK) {
+		ring[i].referenced = true;
+	} else {
+		push_front(take(i));
+	}
+}
+
+static void model_put(StremCacheMode mode, uint64_t key, uint64_t value) {
+	const size_t i = find(key);
+	if(i != ring_size) {
+		model_touch(mode, i);
+		ring[mode == STREM_CACHE_CLOCK ? i : 0].value = value;
+		return;
+	}
+	if(ring_size == CAPACITY) {
+		if(mode == STREM_CACHE_CLOCK) {
+			while(ring[0].referenced) {
+				ring[0].referenced = false;
+				push_back(take(0));
+			}
+			take(0);
+		} else {
+			take(ring_size - 1);
+		}
+		evictions++;
+	}
+	const Entry entry = { key, value, false };
+	if(mode == STREM_CACHE_CLOCK) {
+		push_back(entry);
+	} else {
+		push_front(entry);
+	}
+}
+
+static void check_all(StremCache* cache) {
+	const size_t hits = cache->hits;
+	const size_t misses = cache->misses;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		/* get would touch entries, so the table is looked at directly */
+		StremCacheNode* const node = StremHashTable_at(&cache->table, &key);
+		const size_t i = find(key);
+		CHECK((node != NULL) == (i != ring_size));
+	}
+	CHECK(cache->hits == hits && cache->misses == misses);
+	CHECK(cache->table.keys.size == ring_size && cache->evictions == evictions);
+}
+
+static void run(StremCacheMode mode) {
+	StremCache cache = StremCache_construct(sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, CAPACITY, mode);
+	CHECK(cache.table.keys.content != NULL);
+	const size_t cap = cache.table.keys.capacity_elems;
+	ring_size = 0;
+	evictions = 0;
+	size_t hits = 0;
+	size_t misses = 0;
+
+	srand(11);
+	for(size_t op = 0; op < OPS; op++) {
+		/* low keys are hot, so recency matters */
+		const uint64_t key = rand() % 2 ? (uint64_t)rand() % (CAPACITY / 2) : (uint64_t)rand() % KEYS;
+		const int action = rand() % 10;
+		if(action < 5) {
+			uint64_t* const value = StremCache_get(&cache, &key);
+			const size_t i = find(key);
+			CHECK((value != NULL) == (i != ring_size));
+			if(value != NULL) {
+				CHECK(*value == ring[i].value);
+				model_touch(mode, i);
+				hits++;
+			} else {
+				misses++;
+			}
+		} else if(action < 9) {
+			const uint64_t value = (uint64_t)op;
+			uint64_t* const cached = StremCache_put(&cache, &key, &value);
+			CHECK(cached != NULL && *cached == value);
+			model_put(mode, key, value);
+		} else {
+			const size_t i = find(key);
+			CHECK(StremCache_remove(&cache, &key) == (i != ring_size));
+			if(i != ring_size) {
+				take(i);
+			}
+		}
+		CHECK(cache.hits == hits && cache.misses == misses);
+		if(op % 1000 == 0) {
+			check_all(&cache);
+		}
+	}
+	check_all(&cache);
+	/* table was sized upfront */
+	CHECK(cache.table.keys.capacity_elems == cap);
+
+	StremCache_free(&cache);
+}
+
+int main(void) {
+	run(STREM_CACHE_LRU);
+	run(STREM_CACHE_CLOCK);
+	puts("test_cache: ok");
+	return 0;
+}
@@ -0,0 +1,104 @@
+// Concurrent table: writers growing the table and removing keys never make readers
+// see a torn value or a key of another writer, and every pair ends where it should.
+// Build: cc -std=c11 -I.. test_cht.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "strem_cht.h"
+#include "check.h"
+
+#define WRITERS 4
+#define READERS 4
+#define KEYS_PER_WRITER 50000
+
+typedef struct {
+	uint64_t a;
+	uint64_t b; /* always ~a, so a torn read shows */
+} Value;
+
+static StremConcurrentHashTable cht;
+static atomic_int writers_left;
+
+// Writer w owns keys w, w + WRITERS, ...; keys divisible by 3 are removed again
+static void* write_keys(void* arg) {
+	const uint64_t writer = (uint64_t)(uintptr_t)arg;
+	for(uint64_t i = 0; i < KEYS_PER_WRITER; i++) {
+		const uint64_t key = i * WRITERS + writer;
+		const Value value = { key, ~key };
+		bool inserted = false;
+		CHECK(StremConcurrentHashTable_insert(&cht, &key, &value, &inserted) && inserted);
+	}
+	for(uint64_t i = 0; i < KEYS_PER_WRITER; i++) {
+		const uint64_t key = i * WRITERS + writer;
+		if(key % 3 == 0) {
+			Value removed;
+			CHECK(StremConcurrentHashTable_remove(&cht, &key, &removed));
+			CHECK(removed.a == key && removed.b == ~key);
+		} else {
+			/* overwrite with the same value */
+			const Value value = { key, ~key };
+			bool inserted = true;
+			CHECK(StremConcurrentHashTable_insert(&cht, &key, &value, &inserted) && !inserted);
+		}
+	}
+	atomic_fetch_sub(&writers_left, 1);
+	return NULL;
+}
+
+static void* read_keys(void* arg) {
+	uint64_t state = (uint64_t)(uintptr_t)arg + 1;
+	while(atomic_load(&writers_left) > 0) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		const uint64_t key = (state >> 33) % (KEYS_PER_WRITER * WRITERS + 1000);
+		Value value;
+		if(StremConcurrentHashTable_at(&cht, &key, &value)) {
+			CHECK(key < KEYS_PER_WRITER * WRITERS);
+			CHECK(value.a == key && value.b == ~key);
+		}
+	}
+	return NULL;
+}
+
+int main(void) {
+	CHECK(StremConcurrentHashTable_construct(&cht, sizeof(uint64_t), sizeof(Value), NULL, NULL));
+	atomic_store(&writers_left, WRITERS);
+
+	pthread_t writers[WRITERS];
+	pthread_t readers[READERS];
+	for(size_t i = 0; i < READERS; i++) {
+		CHECK(pthread_create(&readers[i], NULL, read_keys, (void*)(uintptr_t)i) == 0);
+	}
+	for(size_t i = 0; i < WRITERS; i++) {
+		CHECK(pthread_create(&writers[i], NULL, write_keys, (void*)(uintptr_t)i) == 0);
+	}
+	for(size_t i = 0; i < WRITERS; i++) {
+		pthread_join(writers[i], NULL);
+	}
+	for(size_t i = 0; i < READERS; i++) {
+		pthread_join(readers[i], NULL);
+	}
+
+	size_t count = 0;
+	for(uint64_t key = 0; key < KEYS_PER_WRITER * WRITERS + 1000; key++) {
+		Value value;
+		const bool found = StremConcurrentHashTable_at(&cht, &key, &value);
+		CHECK(found == (key < KEYS_PER_WRITER * WRITERS && key % 3 != 0));
+		CHECK(!found || (value.a == key && value.b == ~key));
+		count += found;
+	}
+	CHECK(StremConcurrentHashTable_size(&cht) == count);
+
+	/* removed slots are reused */
+	for(uint64_t key = 0; key < KEYS_PER_WRITER * WRITERS; key += 3) {
+		const Value value = { key, ~key };
+		bool inserted = false;
+		CHECK(StremConcurrentHashTable_insert(&cht, &key, &value, &inserted) && inserted);
+	}
+	CHECK(StremConcurrentHashTable_size(&cht) == KEYS_PER_WRITER * WRITERS);
+	const uint64_t missing = KEYS_PER_WRITER * WRITERS;
+	CHECK(!StremConcurrentHashTable_remove(&cht, &missing, NULL));
+
+	StremConcurrentHashTable_free(&cht);
+	puts("test_cht: ok");
+	return 0;
+}
@@ -0,0 +1,132 @@
+// Cuckoo set: keys moved between their two buckets stay reachable, buckets sit on
+// cache lines, and an insert that can't be placed fails without changing the set.
+// Build: cc -std=c11 -I.. test_cuckoo.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include "strem_cuckoo.h"
+#include "check.h"
+
+#define KEYS 100000
+#define OPS 300000
+
+static bool live[KEYS];
+
+static size_t same_hash(void const* key) {
+	(void)key;
+	return 42;
+}
+
+static void check_all(StremCuckooSet* cs, size_t key_count) {
+	size_t count = 0;
+	for(uint64_t key = 0; key < key_count; key++) {
+		uint64_t* const set_key = StremCuckooSet_at(cs, &key);
+		CHECK((set_key != NULL) == live[key] && (set_key == NULL || *set_key == key));
+		count += live[key];
+	}
+	CHECK(cs->size == count);
+}
+
+// Built-in kernels, random inserts and removes at growing and shrinking load
+static void churn(void) {
+	StremCuckooSet cs = StremCuckooSet_construct(sizeof(uint64_t), NULL, NULL);
+	CHECK(cs.buckets != NULL);
+	CHECK((uintptr_t)cs.buckets % STREM_CUCKOO_LINE == 0);
+
+	for(uint64_t key = 0; key < KEYS; key++) {
+		uint64_t* const set_key = StremCuckooSet_insert(&cs, &key);
+		CHECK(set_key != NULL && *set_key == key);
+		live[key] = true;
+	}
+	check_all(&cs, KEYS);
+	uint64_t again = 7;
+	CHECK(StremCuckooSet_insert(&cs, &again) == StremCuckooSet_at(&cs, &again));
+	CHECK(cs.size == KEYS);
+
+	srand(3);
+	for(size_t op = 0; op < OPS; op++) {
+		const uint64_t key = (uint64_t)rand() % KEYS;
+		if(live[key]) {
+			uint64_t* const removed = StremCuckooSet_remove(&cs, &key);
+			CHECK(removed != NULL && *removed == key);
+		} else {
+			uint64_t* const set_key = StremCuckooSet_insert(&cs, &key);
+			CHECK(set_key != NULL && *set_key == key);
+		}
+		live[key] = !live[key];
+	}
+	check_all(&cs, KEYS);
+
+	/* too few buckets even 16 times over: set is kept as it was */
+	const size_t bucket_count = cs.bucket_count;
+	CHECK(!StremCuckooSet_resize(&cs, 1));
+	CHECK(cs.bucket_count == bucket_count);
+	check_all(&cs, KEYS);
+	CHECK(StremCuckooSet_resize(&cs, bucket_count * 2));
+	check_all(&cs, KEYS);
+	CHECK(StremCuckooSet_resize(&cs, bucket_count / 2));
+	CHECK(cs.bucket_count >= bucket_count / 2);
+	check_all(&cs, KEYS);
+
+	StremCuckooSet_free(&cs);
+}
+
+// Keys sharing a hash share both buckets, so only two buckets of them fit
+static void colliding(void) {
+	StremCuckooSet cs = StremCuckooSet_construct(sizeof(uint64_t), same_hash, NULL);
+	CHECK(cs.buckets != NULL);
+	for(size_t i = 0; i < KEYS; i++) {
+		live[i] = false;
+	}
+
+	size_t stored = 0;
+	for(uint64_t key = 0; key < 4 * STREM_CUCKOO_SLOTS; key++) {
+		const size_t bucket_count = cs.bucket_count;
+		uint64_t* const set_key = StremCuckooSet_insert(&cs, &key);
+		if(set_key != NULL) {
+			CHECK(*set_key == key);
+			live[key] = true;
+			stored++;
+		} else {
+			/* failed insert grows at most a bounded number of times and loses nothing */
+			CHECK(cs.bucket_count <= bucket_count << 16);
+		}
+		check_all(&cs, 4 * STREM_CUCKOO_SLOTS);
+	}
+	CHECK(stored == 2 * STREM_CUCKOO_SLOTS);
+
+	StremCuckooSet_free(&cs);
+}
+
+// Emplaced set starts at the first line boundary and fails instead of growing
+static void emplaced(void) {
+	static char buf[64 * STREM_CUCKOO_LINE + 8];
+	StremCuckooSet cs = StremCuckooSet_emplace(buf + 8, sizeof(buf) - 8, sizeof(uint64_t), NULL, NULL);
+	CHECK(cs.buckets != NULL);
+	CHECK((uintptr_t)cs.buckets % STREM_CUCKOO_LINE == 0);
+	CHECK((char*)cs.buckets >= buf + 8);
+	for(size_t i = 0; i < KEYS; i++) {
+		live[i] = false;
+	}
+
+	const size_t bucket_count = cs.bucket_count;
+	bool full = false;
+	for(uint64_t key = 0; key < 64 * STREM_CUCKOO_SLOTS && !full; key++) {
+		uint64_t* const set_key = StremCuckooSet_insert(&cs, &key);
+		full = set_key == NULL;
+		live[key] = !full;
+	}
+	CHECK(full && cs.bucket_count == bucket_count);
+	CHECK(cs.size > bucket_count * STREM_CUCKOO_SLOTS / 2);
+	check_all(&cs, 64 * STREM_CUCKOO_SLOTS);
+	CHECK(!StremCuckooSet_resize(&cs, bucket_count * 2));
+
+	StremCuckooSet_free(&cs);
+}
+
+int main(void) {
+	churn();
+	colliding();
+	emplaced();
+	puts("test_cuckoo: ok");
+	return 0;
+}
@@ -0,0 +1,118 @@
+// Dict keeps insertion order through removes, overwrites, compaction and index widening
+// (1, 2, then 4 bytes per entry number), and finds every key on the way.
+// Build: cc -std=c11 -I.. test_dict.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include "strem_dict.h"
+#include "check.h"
+
+#define KEYS 70000
+
+// Insertion order model: keys in order of their last insert as a new pair
+static uint32_t order[KEYS * 2];
+static size_t order_size;
+static size_t placed_at[KEYS]; /* in order, for live keys */
+static bool live[KEYS];
+
+static void check_all(StremDict* d) {
+	size_t count = 0;
+	for(uint32_t key = 0; key < KEYS; key++) {
+		uint64_t* const value = StremDict_at(d, &key);
+		CHECK((value != NULL) == live[key] && (value == NULL || *value == (uint64_t)key * 9));
+		count += live[key];
+	}
+	CHECK(d->size == count);
+
+	size_t next = 0;
+	void* key;
+	void* value;
+	for(size_t pos = 0; StremDict_next(d, &pos, &key, &value);) {
+		while(!live[order[next]] || placed_at[order[next]] != next) {
+			next++;
+		}
+		CHECK(*(uint32_t*)key == order[next]);
+		CHECK(*(uint64_t*)value == (uint64_t)order[next] * 9);
+		next++;
+		count--;
+	}
+	CHECK(count == 0);
+}
+
+static void insert(StremDict* d, uint32_t key) {
+	const uint64_t value = (uint64_t)key * 9;
+	uint64_t* const inserted = StremDict_insert(d, &key, &value);
+	CHECK(inserted != NULL && *inserted == value);
+	if(!live[key]) {
+		placed_at[key] = order_size;
+		order[order_size++] = key;
+		live[key] = true;
+	}
+}
+
+static void erase(StremDict* d, uint32_t key) {
+	uint64_t* const removed = StremDict_remove(d, &key);
+	CHECK(removed != NULL && *removed == (uint64_t)key * 9);
+	live[key] = false;
+}
+
+int main(void) {
+	/* 4-byte keys are padded, so values stay aligned */
+	StremDict d = StremDict_construct(sizeof(uint32_t), sizeof(uint64_t), NULL, NULL);
+	CHECK(d.index != NULL);
+	check_all(&d);
+
+	for(uint32_t key = 0; key < KEYS; key += 2) {
+		insert(&d, key);
+		if(key == 200 || key == 60000) {
+			check_all(&d);
+		}
+	}
+	check_all(&d);
+
+	/* overwrite keeps place in order, reinsert of removed key goes to the end */
+	for(uint32_t key = 0; key < KEYS; key += 6) {
+		insert(&d, key);
+	}
+	for(uint32_t key = 0; key < KEYS; key += 4) {
+		erase(&d, key);
+	}
+	check_all(&d);
+	for(uint32_t key = 0; key < KEYS; key += 8) {
+		insert(&d, key);
+	}
+	check_all(&d);
+	const uint32_t missing = 1;
+	CHECK(StremDict_remove(&d, &missing) == NULL);
+
+	/* removing most pairs compacts entries, order survives */
+	for(uint32_t key = 0; key < KEYS; key++) {
+		if(live[key] && key % 10 != 0) {
+			erase(&d, key);
+		}
+	}
+	check_all(&d);
+	for(uint32_t key = 1; key < KEYS; key += 2) {
+		insert(&d, key);
+	}
+	check_all(&d);
+
+	/* reserved room takes inserts without moving values */
+	CHECK(StremDict_reserve(&d, d.size + 1000));
+	size_t pos = 0;
+	void* first_key;
+	void* first_value;
+	CHECK(StremDict_next(&d, &pos, &first_key, &first_value));
+	const uint32_t first = *(uint32_t*)first_key;
+	for(uint32_t key = 0, inserted = 0; key < KEYS && inserted < 1000; key++) {
+		if(!live[key]) {
+			insert(&d, key);
+			inserted++;
+		}
+	}
+	CHECK(StremDict_at(&d, &first) == first_value);
+	check_all(&d);
+
+	StremDict_free(&d);
+	puts("test_dict: ok");
+	return 0;
+}
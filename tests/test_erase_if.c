@@ -0,0 +1,112 @@
+// Erase_if removes exactly the keys its predicate picks in one pass, in every mode:
+// kept keys stay reachable, robin hood leaves no dead slots, value slots are reused.
+// Build: cc -std=c11 -I.. test_erase_if.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "check.h"
+
+#define KEYS 20000
+
+static bool live[KEYS];
+
+// Keys of the same eighth share a hash, so erased keys sit inside chains of 8 or more
+static size_t clustered_hash(void const* key) {
+	return (size_t)(*(uint64_t const*)key / 8 * 0x9E3779B97F4A7C15ull);
+}
+
+static bool pair_divisible(void const* key, void* value, void* ctx) {
+	const uint64_t divisor = *(uint64_t const*)ctx;
+	CHECK(*(uint64_t const*)value == *(uint64_t const*)key + 1);
+	return *(uint64_t const*)key % divisor == 0;
+}
+
+static bool key_divisible(void const* key, void* ctx) {
+	return *(uint64_t const*)key % *(uint64_t const*)ctx == 0;
+}
+
+static void check_all(StremHashTable* ht, StremHashSet* hs) {
+	size_t count = 0;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		uint64_t* const value = StremHashTable_at(ht, &key);
+		uint64_t* const set_key = StremHashSet_at(hs, &key);
+		CHECK((value != NULL) == live[key] && (value == NULL || *value == key + 1));
+		CHECK((set_key != NULL) == live[key]);
+		count += live[key];
+	}
+	CHECK(StremHashTable_stats(ht).size == count && StremHashSet_stats(hs).size == count);
+}
+
+static size_t erase_expected(uint64_t divisor) {
+	size_t erased = 0;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		if(live[key] && key % divisor == 0) {
+			live[key] = false;
+			erased++;
+		}
+	}
+	return erased;
+}
+
+static void run(int ht_mode, StremHSMode hs_mode, StremHashFunction func) {
+	StremHashTable ht = StremHashTable_construct_mode(
+		sizeof(uint64_t), sizeof(uint64_t), func, NULL, (StremHTMode)ht_mode
+	);
+	StremHashSet hs = StremHashSet_construct_mode(sizeof(uint64_t), func, NULL, hs_mode);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+	memset(live, 0, sizeof(live));
+
+	for(uint64_t key = 0; key < KEYS; key++) {
+		const uint64_t value = key + 1;
+		void* const inserted_value = StremHashTable_insert(&ht, &key, &value);
+		void* const inserted_key = StremHashSet_insert(&hs, &key);
+		CHECK(inserted_value != NULL && inserted_key != NULL);
+		live[key] = true;
+	}
+
+	static const uint64_t divisors[] = { 3, 2, 5, 1 };
+	for(size_t d = 0; d < sizeof(divisors) / sizeof(divisors[0]); d++) {
+		uint64_t divisor = divisors[d];
+		const size_t expected = erase_expected(divisor);
+		const size_t table_erased = StremHashTable_erase_if(&ht, pair_divisible, &divisor);
+		const size_t set_erased = StremHashSet_erase_if(&hs, key_divisible, &divisor);
+		CHECK(table_erased == expected && set_erased == expected);
+		check_all(&ht, &hs);
+		if(hs_mode == STREM_HS_ROBIN_HOOD) {
+			CHECK(StremHashTable_stats(&ht).tombstones == 0);
+			CHECK(StremHashSet_stats(&hs).tombstones == 0);
+		}
+
+		/* erased value slots are taken by the next inserts */
+		const size_t value_bytes = StremHashTable_stats(&ht).value_bytes
+			+ StremHashTable_stats(&ht).dead_value_bytes;
+		for(uint64_t key = 0; key < KEYS; key += 7) {
+			if(!live[key]) {
+				const uint64_t value = key + 1;
+				void* const inserted_value = StremHashTable_insert(&ht, &key, &value);
+				void* const inserted_key = StremHashSet_insert(&hs, &key);
+				CHECK(inserted_value != NULL && inserted_key != NULL);
+				live[key] = true;
+			}
+		}
+		check_all(&ht, &hs);
+		CHECK(StremHashTable_stats(&ht).value_bytes + StremHashTable_stats(&ht).dead_value_bytes == value_bytes);
+	}
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+}
+
+int main(void) {
+	run(STREM_HT_LINEAR, STREM_HS_LINEAR, NULL);
+	run(STREM_HT_GROUP, STREM_HS_GROUP, NULL);
+	run(STREM_HT_ROBIN_HOOD, STREM_HS_ROBIN_HOOD, NULL);
+	run(STREM_HT_ROBIN_HOOD, STREM_HS_ROBIN_HOOD, clustered_hash);
+	/* erase_if finishes the move of old slots first */
+	run(STREM_HT_LINEAR | STREM_HT_INCREMENTAL, STREM_HS_LINEAR, NULL);
+	run(STREM_HT_ROBIN_HOOD | STREM_HT_INCREMENTAL, STREM_HS_ROBIN_HOOD, clustered_hash);
+	puts("test_erase_if: ok");
+	return 0;
+}
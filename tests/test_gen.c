@@ -0,0 +1,59 @@
+// Churn of inserts and removes must leave empty slots, so a miss ends.
+// Build: cc -std=c11 -I.. test_gen.c && ./a.out
+#include <stdint.h>
+#include "strem_gen.h"
+#include "check.h"
+
+#define HASH_U64(key) ((size_t)(key))
+#define EQ_U64(a, b) ((a) == (b))
+
+STREM_HT_DEFINE(U64Map, uint64_t, uint64_t, HASH_U64, EQ_U64)
+STREM_HS_DEFINE(U64Set, uint64_t, HASH_U64, EQ_U64)
+
+static void insert_both(U64Map* map, U64Set* set, uint64_t key, uint64_t value) {
+	uint64_t* const map_value = U64Map_insert(map, key, value);
+	uint64_t* const set_key = U64Set_insert(set, key);
+	CHECK(map_value != NULL && *map_value == value);
+	CHECK(set_key != NULL && *set_key == key);
+}
+
+static void remove_both(U64Map* map, U64Set* set, uint64_t key) {
+	uint64_t* const map_value = U64Map_remove(map, key);
+	uint64_t* const set_key = U64Set_remove(set, key);
+	CHECK(map_value != NULL);
+	CHECK(set_key != NULL);
+}
+
+int main(void) {
+	U64Map map = U64Map_construct();
+	U64Set set = U64Set_construct();
+	CHECK(map.slots != NULL && set.slots != NULL);
+
+	for(uint64_t key = 0; key < 1000; key++) {
+		insert_both(&map, &set, key, key);
+		remove_both(&map, &set, key);
+	}
+	CHECK(map.cap == STREM_GEN_DEFAULT_CAP && set.cap == STREM_GEN_DEFAULT_CAP);
+	CHECK(U64Map_at(&map, 5000) == NULL);
+	CHECK(U64Set_at(&set, 5000) == NULL);
+
+	/* live keys survive purges */
+	for(uint64_t key = 0; key < 1000; key++) {
+		insert_both(&map, &set, key, key * 2);
+		if(key % 4 != 0) {
+			remove_both(&map, &set, key);
+		}
+	}
+	for(uint64_t key = 0; key < 1000; key++) {
+		uint64_t* const value = U64Map_at(&map, key);
+		uint64_t* const set_key = U64Set_at(&set, key);
+		CHECK((value != NULL) == (key % 4 == 0) && (value == NULL || *value == key * 2));
+		CHECK((set_key != NULL) == (key % 4 == 0));
+	}
+	CHECK(U64Map_at(&map, 5000) == NULL);
+
+	U64Map_free(&map);
+	U64Set_free(&set);
+	puts("test_gen: ok");
+	return 0;
+}
@@ -0,0 +1,106 @@
+// Incremental resize: while old slots are being moved, every operation sees keys
+// of both generations, and nothing is lost or duplicated when the move ends.
+// Build: cc -std=c11 -I.. test_incremental.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_ht.h"
+#include "check.h"
+
+#define KEYS 20000
+
+static bool live[KEYS];
+
+static bool migrating(StremHashTable const* ht) {
+	return ht->old_keys.content != NULL;
+}
+
+static void check_all(StremHashTable* ht) {
+	uint64_t keys[KEYS];
+	void* values[KEYS];
+	size_t count = 0;
+
+	for(uint64_t key = 0; key < KEYS; key++) {
+		keys[key] = key;
+		count += live[key];
+	}
+	StremHashTable_at_batch(ht, keys, KEYS, values);
+	for(uint64_t key = 0; key < KEYS; key++) {
+		uint64_t* const value = StremHashTable_at(ht, &key);
+		CHECK((value != NULL) == live[key] && (value == NULL || *value == key + 1));
+		CHECK(values[key] == value);
+	}
+	CHECK(ht->keys.size + (migrating(ht) ? ht->old_keys.size : 0) >= count);
+	CHECK(StremHashTable_stats(ht).size == count);
+}
+
+static void run(StremHTMode mode) {
+	StremHashTable ht = StremHashTable_construct_mode(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, mode | STREM_HT_INCREMENTAL
+	);
+	CHECK(ht.keys.content != NULL);
+	memset(live, 0, sizeof(live));
+	size_t checked_migrations = 0;
+
+	for(uint64_t key = 0; key < KEYS; key++) {
+		const uint64_t value = key + 1;
+		bool inserted = false;
+		uint64_t* const new_value = StremHashTable_find_or_insert(&ht, &key, &inserted);
+		CHECK(new_value != NULL && inserted);
+		*new_value = value;
+		live[key] = true;
+
+		if(migrating(&ht) && key % 7 == 0) {
+			/* key inserted before growth is found in old arrays, not inserted twice */
+			const uint64_t old_key = key / 2;
+			uint64_t* const old_value = StremHashTable_find_or_insert(&ht, &old_key, &inserted);
+			CHECK(old_value != NULL && !inserted && *old_value == old_key + 1);
+
+			uint64_t* const removed = StremHashTable_remove(&ht, &old_key);
+			CHECK(removed != NULL && *removed == old_key + 1);
+			live[old_key] = false;
+			CHECK(StremHashTable_at(&ht, &old_key) == NULL);
+
+			const uint64_t old_value_again = old_key + 1;
+			CHECK(StremHashTable_upsert(&ht, &old_key, &old_value_again, NULL) != NULL);
+			live[old_key] = true;
+
+			if(checked_migrations++ % 64 == 0) {
+				check_all(&ht);
+			}
+		}
+	}
+	CHECK(checked_migrations > 0);
+	check_all(&ht);
+
+	/* mostly dead table migrates to arrays of the same capacity */
+	const size_t cap = ht.keys.capacity_elems;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		if(key % 8 != 0) {
+			uint64_t* const removed = StremHashTable_remove(&ht, &key);
+			CHECK(removed != NULL);
+			live[key] = false;
+		}
+	}
+	for(uint64_t key = 1; key < KEYS; key += 8) {
+		const uint64_t value = key + 1;
+		CHECK(StremHashTable_insert(&ht, &key, &value) != NULL);
+		live[key] = true;
+	}
+	check_all(&ht);
+	CHECK(ht.keys.capacity_elems == cap);
+
+	StremHashTable_purge(&ht);
+	CHECK(!migrating(&ht));
+	check_all(&ht);
+
+	StremHashTable_free(&ht);
+}
+
+int main(void) {
+	run(STREM_HT_LINEAR);
+	run(STREM_HT_GROUP);
+	run(STREM_HT_ROBIN_HOOD);
+	puts("test_incremental: ok");
+	return 0;
+}
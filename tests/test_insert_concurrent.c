@@ -0,0 +1,79 @@
+// Concurrent insert: threads inserting overlapping keys store each key once,
+// exactly one of them is told it inserted it, and all get the same pointer.
+// Build: cc -std=c11 -I.. test_insert_concurrent.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "strem_hs.h"
+#include "check.h"
+
+#define THREADS 4
+#define KEYS 40000
+
+static StremHashSet hs;
+static void* found[THREADS][KEYS];
+static bool inserted_by[THREADS][KEYS];
+
+// Every thread inserts all keys, starting at its own offset, so threads race on each key
+static void* insert_keys(void* arg) {
+	const size_t thread = (size_t)(uintptr_t)arg;
+	for(size_t i = 0; i < KEYS; i++) {
+		const uint64_t key = (i + thread * (KEYS / THREADS)) % KEYS;
+		found[thread][key] = StremHashSet_insert_concurrent(&hs, &key, &inserted_by[thread][key]);
+	}
+	return NULL;
+}
+
+static void run(StremIndexPolicy index_policy, StremProbeSequence probe_seq, bool bloom) {
+	hs = StremHashSet_construct_policy(sizeof(uint64_t), NULL, NULL, STREM_HS_LINEAR, index_policy, probe_seq);
+	CHECK(hs.keys != NULL);
+	CHECK(StremHashSet_reserve(&hs, KEYS));
+	CHECK(!bloom || StremHashSet_enable_bloom(&hs));
+
+	pthread_t ids[THREADS];
+	for(size_t t = 0; t < THREADS; t++) {
+		CHECK(pthread_create(&ids[t], NULL, insert_keys, (void*)(uintptr_t)t) == 0);
+	}
+	for(size_t t = 0; t < THREADS; t++) {
+		pthread_join(ids[t], NULL);
+	}
+
+	for(uint64_t key = 0; key < KEYS; key++) {
+		size_t inserters = 0;
+		for(size_t t = 0; t < THREADS; t++) {
+			CHECK(found[t][key] != NULL && found[t][key] == found[0][key]);
+			inserters += inserted_by[t][key];
+		}
+		CHECK(inserters == 1);
+		uint64_t* const set_key = StremHashSet_at(&hs, &key);
+		CHECK(set_key == found[0][key] && *set_key == key);
+	}
+	const uint64_t missing = KEYS;
+	CHECK(StremHashSet_at(&hs, &missing) == NULL);
+	CHECK(StremHashSet_stats(&hs).size == KEYS);
+
+	StremHashSet_free(&hs);
+}
+
+int main(void) {
+	run(STREM_INDEX_MODULO, STREM_SEQ_GAP, false);
+	run(STREM_INDEX_MASK, STREM_SEQ_LINEAR, true);
+	run(STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR, false);
+	run(STREM_INDEX_FASTRANGE, STREM_SEQ_LINEAR, false);
+
+	/* set with no room left reports it instead of growing */
+	uint64_t buf[64];
+	hs = StremHashSet_emplace(buf, sizeof(buf), sizeof(uint64_t), NULL, NULL, false);
+	CHECK(hs.keys != NULL);
+	size_t stored = 0;
+	for(uint64_t key = 0; key < 64; key++) {
+		bool inserted = false;
+		stored += StremHashSet_insert_concurrent(&hs, &key, &inserted) != NULL && inserted;
+	}
+	CHECK(stored > 0 && stored < 64);
+	CHECK(StremHashSet_stats(&hs).size == stored);
+	StremHashSet_free(&hs);
+
+	puts("test_insert_concurrent: ok");
+	return 0;
+}
@@ -0,0 +1,103 @@
+// Partitioned group-by and join agree with a plain count, for uniform and skewed keys
+// and any number of threads; emit is called once per matching probe row.
+// Build: cc -std=c11 -I.. test_join.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_join.h"
+#include "check.h"
+
+#define ROWS 200000
+#define DISTINCT 50000
+#define PROBES 100000
+#define MAX_THREADS 64
+
+static uint64_t keys[ROWS];
+static uint64_t ones[ROWS];
+static uint64_t expected[DISTINCT * 2];
+static uint64_t probe_keys[PROBES];
+
+typedef struct {
+	size_t threads;
+	uint8_t emitted[PROBES]; /* times probe row was emitted, rows are split between threads */
+	size_t per_thread[MAX_THREADS];
+} Emitted;
+
+static void sum(void* existing, void const* value) {
+	*(uint64_t*)existing += *(uint64_t const*)value;
+}
+
+static void emit(void* ctx, size_t thread, size_t row, void* value) {
+	Emitted* const emitted = ctx;
+	CHECK(thread < emitted->threads && row < PROBES);
+	CHECK(*(uint64_t*)value == expected[probe_keys[row]]);
+	emitted->emitted[row]++;
+	emitted->per_thread[thread]++;
+}
+
+static void run(bool skewed, size_t threads) {
+	memset(expected, 0, sizeof(expected));
+	srand(5);
+	for(size_t i = 0; i < ROWS; i++) {
+		/* skewed: half of rows share a handful of hot keys */
+		keys[i] = skewed && i % 2 == 0 ? (uint64_t)rand() % 4 : (uint64_t)rand() % DISTINCT;
+		ones[i] = 1;
+		expected[keys[i]]++;
+	}
+
+	StremPartitionedTable pt;
+	CHECK(StremPartitionedTable_group_by(
+		&pt, keys, ones, ROWS, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, sum, threads
+	));
+	for(uint64_t key = 0; key < DISTINCT * 2; key++) {
+		uint64_t* const count = StremPartitionedTable_at(&pt, &key);
+		CHECK((count != NULL) == (expected[key] != 0) && (count == NULL || *count == expected[key]));
+	}
+
+	/* half of probe keys are absent from table */
+	for(size_t i = 0; i < PROBES; i++) {
+		probe_keys[i] = (uint64_t)rand() % (DISTINCT * 2);
+	}
+	static Emitted emitted;
+	memset(&emitted, 0, sizeof(emitted));
+	emitted.threads = threads == 0 ? 1 : threads < MAX_THREADS ? threads : MAX_THREADS;
+	CHECK(StremPartitionedTable_join(&pt, probe_keys, PROBES, emit, &emitted, threads));
+	size_t matches = 0;
+	for(size_t i = 0; i < PROBES; i++) {
+		CHECK(emitted.emitted[i] == (expected[probe_keys[i]] != 0));
+		matches += emitted.emitted[i];
+	}
+	size_t emitted_total = 0;
+	for(size_t t = 0; t < MAX_THREADS; t++) {
+		emitted_total += emitted.per_thread[t];
+	}
+	CHECK(emitted_total == matches);
+
+	StremPartitionedTable_free(&pt);
+}
+
+int main(void) {
+	static const size_t thread_counts[] = { 0, 1, 4, 1000 };
+	for(size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+		run(false, thread_counts[t]);
+		run(true, thread_counts[t]);
+	}
+
+	/* last value is kept without merge */
+	StremPartitionedTable pt;
+	const uint64_t dup_keys[] = { 3, 5, 3, 3 };
+	const uint64_t dup_values[] = { 1, 2, 3, 4 };
+	CHECK(StremPartitionedTable_group_by(
+		&pt, dup_keys, dup_values, 4, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, NULL, 2
+	));
+	const uint64_t three = 3;
+	const uint64_t five = 5;
+	const uint64_t four = 4;
+	CHECK(*(uint64_t*)StremPartitionedTable_at(&pt, &three) == 4);
+	CHECK(*(uint64_t*)StremPartitionedTable_at(&pt, &five) == 2);
+	CHECK(StremPartitionedTable_at(&pt, &four) == NULL);
+	StremPartitionedTable_free(&pt);
+
+	puts("test_join: ok");
+	return 0;
+}
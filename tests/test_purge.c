@@ -0,0 +1,141 @@
+// Purge rehashes in place: dead slots turn empty, live keys stay reachable, capacity
+// is kept, and a churning container purges instead of growing without bound.
+// Build: cc -std=c11 -I.. test_purge.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "check.h"
+
+#define KEYS 8192
+#define LIVE 600
+#define CHURN 100000
+
+static bool live[KEYS];
+
+static void check_all(StremHashTable* ht, StremHashSet* hs) {
+	size_t count = 0;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		uint64_t* const value = StremHashTable_at(ht, &key);
+		uint64_t* const set_key = StremHashSet_at(hs, &key);
+		CHECK((value != NULL) == live[key] && (value == NULL || *value == key + 1));
+		CHECK((set_key != NULL) == live[key] && (set_key == NULL || *set_key == key));
+		count += live[key];
+	}
+	const StremHashStats ht_stats = StremHashTable_stats(ht);
+	const StremHashStats hs_stats = StremHashSet_stats(hs);
+	CHECK(ht_stats.size == count && hs_stats.size == count);
+	/* dead slots count towards saturation, one insert may go past it */
+	CHECK(ht_stats.size + ht_stats.tombstones <= (size_t)(ht_stats.cap * ht->saturation) + 1);
+	CHECK(hs_stats.size + hs_stats.tombstones <= (size_t)(hs_stats.cap * hs->saturation) + 1);
+}
+
+static void insert_both(StremHashTable* ht, StremHashSet* hs, uint64_t key) {
+	const uint64_t value = key + 1;
+	void* const inserted_value = StremHashTable_insert(ht, &key, &value);
+	void* const inserted_key = StremHashSet_insert(hs, &key);
+	CHECK(inserted_value != NULL && inserted_key != NULL);
+	live[key] = true;
+}
+
+static void remove_both(StremHashTable* ht, StremHashSet* hs, uint64_t key) {
+	uint64_t* const value = StremHashTable_remove(ht, &key);
+	void* const set_key = StremHashSet_remove(hs, &key);
+	CHECK(value != NULL && *value == key + 1 && set_key != NULL);
+	live[key] = false;
+}
+
+static void run(StremHTMode ht_mode, StremHSMode hs_mode, StremIndexPolicy index_policy, StremProbeSequence probe_seq) {
+	StremHashTable ht = StremHashTable_construct_policy(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, ht_mode, index_policy, probe_seq
+	);
+	StremHashSet hs = StremHashSet_construct_policy(
+		sizeof(uint64_t), NULL, NULL, hs_mode, index_policy, probe_seq
+	);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+	memset(live, 0, sizeof(live));
+
+	/* explicit purge after removing most keys */
+	for(uint64_t key = 0; key < KEYS; key++) {
+		insert_both(&ht, &hs, key);
+	}
+	for(uint64_t key = 0; key < KEYS; key++) {
+		if(key % 4 != 0) {
+			remove_both(&ht, &hs, key);
+		}
+	}
+	CHECK(StremHashTable_stats(&ht).tombstones > 0 && StremHashSet_stats(&hs).tombstones > 0);
+	const StremHashStats ht_before = StremHashTable_stats(&ht);
+	const StremHashStats hs_before = StremHashSet_stats(&hs);
+
+	StremHashTable_purge(&ht);
+	StremHashSet_purge(&hs);
+	const StremHashStats ht_after = StremHashTable_stats(&ht);
+	const StremHashStats hs_after = StremHashSet_stats(&hs);
+	CHECK(ht_after.tombstones == 0 && hs_after.tombstones == 0);
+	CHECK(ht_after.cap == ht_before.cap && hs_after.cap == hs_before.cap);
+	CHECK(ht_after.resizes == ht_before.resizes && hs_after.resizes == hs_before.resizes);
+	check_all(&ht, &hs);
+
+	/* purged slots are reused */
+	for(uint64_t key = 1; key < KEYS; key += 4) {
+		insert_both(&ht, &hs, key);
+	}
+	check_all(&ht, &hs);
+	for(uint64_t key = 0; key < KEYS; key++) {
+		if(live[key]) {
+			remove_both(&ht, &hs, key);
+		}
+	}
+	check_all(&ht, &hs);
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+}
+
+// A window of live keys slides over the key space. Dead slots are purged on insert,
+// so they never fill the table, and capacity settles instead of growing with every lap.
+static void churn(StremHTMode ht_mode, StremHSMode hs_mode) {
+	StremHashTable ht = StremHashTable_construct_mode(sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, ht_mode);
+	StremHashSet hs = StremHashSet_construct_mode(sizeof(uint64_t), NULL, NULL, hs_mode);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+	memset(live, 0, sizeof(live));
+
+	for(uint64_t key = 0; key < LIVE; key++) {
+		insert_both(&ht, &hs, key);
+	}
+	size_t ht_resizes = 0;
+	size_t hs_resizes = 0;
+	for(size_t op = 0; op < CHURN; op++) {
+		/* the first lap may still grow once, since dead slots take room too */
+		if(op == KEYS) {
+			ht_resizes = StremHashTable_stats(&ht).resizes;
+			hs_resizes = StremHashSet_stats(&hs).resizes;
+		}
+		remove_both(&ht, &hs, op % KEYS);
+		insert_both(&ht, &hs, (op + LIVE) % KEYS);
+		if(op % 20000 == 0) {
+			check_all(&ht, &hs);
+		}
+	}
+	check_all(&ht, &hs);
+	CHECK(StremHashTable_stats(&ht).resizes == ht_resizes);
+	CHECK(StremHashSet_stats(&hs).resizes == hs_resizes);
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+}
+
+int main(void) {
+	run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_MODULO, STREM_SEQ_GAP);
+	run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_MASK, STREM_SEQ_LINEAR);
+	run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR);
+	run(STREM_HT_LINEAR, STREM_HS_LINEAR, STREM_INDEX_FASTRANGE, STREM_SEQ_GAP);
+	run(STREM_HT_GROUP, STREM_HS_GROUP, STREM_INDEX_MODULO, STREM_SEQ_GAP);
+	run(STREM_HT_GROUP, STREM_HS_GROUP, STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR);
+	churn(STREM_HT_LINEAR, STREM_HS_LINEAR);
+	churn(STREM_HT_GROUP, STREM_HS_GROUP);
+	puts("test_purge: ok");
+	return 0;
+}
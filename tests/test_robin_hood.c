@@ -0,0 +1,92 @@
+// Robin hood removes shift chains back: no dead slots are left, every key stays reachable
+// and misses still end early.
+// Build: cc -std=c11 -I.. test_robin_hood.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "check.h"
+
+#define KEYS 4096
+#define OPS 200000
+
+static bool live[KEYS];
+
+// Keys of the same eighth share a hash, so chains are long and interleaved
+static size_t clustered_hash(void const* key) {
+	return (size_t)(*(uint64_t const*)key / 8);
+}
+
+static void check_all(StremHashTable* ht, StremHashSet* hs) {
+	size_t count = 0;
+	for(uint64_t key = 0; key < KEYS; key++) {
+		uint64_t* const value = StremHashTable_at(ht, &key);
+		uint64_t* const set_key = StremHashSet_at(hs, &key);
+		CHECK((value != NULL) == live[key] && (value == NULL || *value == key * 3));
+		CHECK((set_key != NULL) == live[key]);
+		count += live[key];
+	}
+	for(uint64_t key = KEYS; key < KEYS + 64; key++) {
+		CHECK(StremHashTable_at(ht, &key) == NULL);
+		CHECK(StremHashSet_at(hs, &key) == NULL);
+	}
+
+	const StremHashStats ht_stats = StremHashTable_stats(ht);
+	const StremHashStats hs_stats = StremHashSet_stats(hs);
+	CHECK(ht_stats.size == count && hs_stats.size == count);
+	CHECK(ht_stats.tombstones == 0 && hs_stats.tombstones == 0);
+}
+
+int main(void) {
+	StremHashTable ht = StremHashTable_construct_mode(
+		sizeof(uint64_t), sizeof(uint64_t), clustered_hash, NULL, STREM_HT_ROBIN_HOOD
+	);
+	StremHashSet hs = StremHashSet_construct_mode(sizeof(uint64_t), clustered_hash, NULL, STREM_HS_ROBIN_HOOD);
+	CHECK(ht.keys.content != NULL && hs.keys != NULL);
+
+	srand(2);
+	for(size_t op = 0; op < OPS; op++) {
+		const uint64_t key = (uint64_t)rand() % KEYS;
+		if(live[key]) {
+			uint64_t* const value = StremHashTable_remove(&ht, &key);
+			void* const set_key = StremHashSet_remove(&hs, &key);
+			CHECK(value != NULL && *value == key * 3);
+			CHECK(set_key != NULL);
+		} else {
+			const uint64_t value = key * 3;
+			void* const inserted_value = StremHashTable_insert(&ht, &key, &value);
+			void* const inserted_key = StremHashSet_insert(&hs, &key);
+			CHECK(inserted_value != NULL && inserted_key != NULL);
+		}
+		live[key] = !live[key];
+
+		if(op % 10000 == 0) {
+			check_all(&ht, &hs);
+		}
+	}
+	check_all(&ht, &hs);
+
+	/* removing every key leaves all slots empty, so fresh keys sit on their home slots */
+	for(uint64_t key = 0; key < KEYS; key++) {
+		if(live[key]) {
+			void* const value = StremHashTable_remove(&ht, &key);
+			void* const set_key = StremHashSet_remove(&hs, &key);
+			CHECK(value != NULL && set_key != NULL);
+			live[key] = false;
+		}
+	}
+	check_all(&ht, &hs);
+	for(uint64_t key = 0; key < KEYS; key += 8) {
+		const uint64_t value = key * 3;
+		void* const inserted_value = StremHashTable_insert(&ht, &key, &value);
+		void* const inserted_key = StremHashSet_insert(&hs, &key);
+		CHECK(inserted_value != NULL && inserted_key != NULL);
+		live[key] = true;
+	}
+	check_all(&ht, &hs);
+
+	StremHashTable_free(&ht);
+	StremHashSet_free(&hs);
+	puts("test_robin_hood: ok");
+	return 0;
+}
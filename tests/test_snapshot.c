@@ -0,0 +1,169 @@
+// Snapshot round trip: a view of written slots answers lookups as the container did,
+// in every mode, and views of snapshots not matching the reader are refused.
+// Build: cc -std=c11 -I.. test_snapshot.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_ht.h"
+#include "strem_hs.h"
+#include "check.h"
+
+#define KEYS 5000
+#define SEED 7
+
+// Reads the whole file into a buffer aligned as a mapped file would be
+static char* read_back(FILE* file, size_t* size) {
+	const long end = ftell(file);
+	CHECK(end > 0);
+	*size = (size_t)end;
+	char* const buf = aligned_alloc(STREM_SNAPSHOT_ALIGN, StremSnapshot_align(*size));
+	CHECK(buf != NULL);
+	rewind(file);
+	CHECK(fread(buf, 1, *size, file) == *size);
+	return buf;
+}
+
+static void table_round_trip(StremHTMode mode, StremIndexPolicy index_policy, StremProbeSequence probe_seq) {
+	StremHashTable ht = StremHashTable_construct_policy(
+		sizeof(uint64_t), sizeof(uint64_t), NULL, NULL, mode, index_policy, probe_seq
+	);
+	CHECK(ht.keys.content != NULL);
+	for(uint64_t key = 0; key < KEYS; key++) {
+		const uint64_t value = key * 5;
+		CHECK(StremHashTable_insert(&ht, &key, &value) != NULL);
+	}
+	/* dead slots are written as they are */
+	for(uint64_t key = 0; key < KEYS; key += 3) {
+		CHECK(StremHashTable_remove(&ht, &key) != NULL);
+	}
+
+	FILE* const file = tmpfile();
+	CHECK(file != NULL);
+	CHECK(StremHashTable_snapshot_write(&ht, file, SEED));
+	size_t size;
+	char* const buf = read_back(file, &size);
+	fclose(file);
+
+	StremHashTable view = StremHashTable_snapshot_view(
+		buf, size, SEED, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL
+	);
+	CHECK(view.keys.content != NULL);
+	uint64_t keys[KEYS + 100];
+	void* values[KEYS + 100];
+	for(uint64_t key = 0; key < KEYS + 100; key++) {
+		keys[key] = key;
+	}
+	StremHashTable_at_batch(&view, keys, KEYS + 100, values);
+	for(uint64_t key = 0; key < KEYS + 100; key++) {
+		uint64_t* const value = StremHashTable_at(&view, &key);
+		const bool present = key < KEYS && key % 3 != 0;
+		CHECK((value != NULL) == present && (value == NULL || *value == key * 5));
+		CHECK(values[key] == value);
+	}
+	StremHashTable_free(&view);
+
+	/* reader expecting other pairs or another seed gets nothing */
+	CHECK(StremHashTable_snapshot_view(buf, size, SEED + 1, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL)
+		.keys.content == NULL);
+	CHECK(StremHashTable_snapshot_view(buf, size, SEED, sizeof(uint64_t), sizeof(uint32_t), NULL, NULL)
+		.keys.content == NULL);
+	CHECK(StremHashTable_snapshot_view(buf, size - 1, SEED, sizeof(uint64_t), sizeof(uint64_t), NULL, NULL)
+		.keys.content == NULL);
+
+	free(buf);
+	StremHashTable_free(&ht);
+}
+
+static void set_round_trip(StremHSMode mode, StremIndexPolicy index_policy, StremProbeSequence probe_seq) {
+	StremHashSet hs = StremHashSet_construct_policy(sizeof(uint64_t), NULL, NULL, mode, index_policy, probe_seq);
+	CHECK(hs.keys != NULL);
+	for(uint64_t key = 0; key < KEYS; key++) {
+		CHECK(StremHashSet_insert(&hs, &key) != NULL);
+	}
+	for(uint64_t key = 0; key < KEYS; key += 3) {
+		CHECK(StremHashSet_remove(&hs, &key) != NULL);
+	}
+
+	FILE* const file = tmpfile();
+	CHECK(file != NULL);
+	CHECK(StremHashSet_snapshot_write(&hs, file, SEED));
+	size_t size;
+	char* const buf = read_back(file, &size);
+	fclose(file);
+
+	StremHashSet view = StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL);
+	CHECK(view.keys != NULL);
+	for(uint64_t key = 0; key < KEYS + 100; key++) {
+		uint64_t* const set_key = StremHashSet_at(&view, &key);
+		const bool present = key < KEYS && key % 3 != 0;
+		CHECK((set_key != NULL) == present && (set_key == NULL || *set_key == key));
+	}
+	StremHashSet_free(&view);
+
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED + 1, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint32_t), NULL, NULL).keys == NULL);
+
+	free(buf);
+	StremHashSet_free(&hs);
+}
+
+// A header edited after writing must not make the view probe out of bounds
+static void corrupt_headers(void) {
+	StremHashSet hs = StremHashSet_construct(sizeof(uint64_t), NULL, NULL);
+	CHECK(hs.keys != NULL);
+	for(uint64_t key = 0; key < 100; key++) {
+		CHECK(StremHashSet_insert(&hs, &key) != NULL);
+	}
+	FILE* const file = tmpfile();
+	CHECK(file != NULL);
+	CHECK(StremHashSet_snapshot_write(&hs, file, SEED));
+	size_t size;
+	char* const buf = read_back(file, &size);
+	fclose(file);
+	StremHashSet_free(&hs);
+
+	StremSnapshotHeader* const header = (StremSnapshotHeader*)buf;
+	const StremSnapshotHeader written = *header;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys != NULL);
+
+	header->magic[0] = 'X';
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->version++;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->index_policy = 7;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->probe_seq = 9;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->index_policy = STREM_INDEX_MODULO;
+	header->probe_seq = STREM_SEQ_TRIANGULAR;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->size = header->cap;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->cap *= 2;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+	*header = written;
+	header->total_size = size + 1;
+	CHECK(StremHashSet_snapshot_view(buf, size, SEED, sizeof(uint64_t), NULL, NULL).keys == NULL);
+
+	free(buf);
+}
+
+int main(void) {
+	table_round_trip(STREM_HT_LINEAR, STREM_INDEX_MODULO, STREM_SEQ_GAP);
+	table_round_trip(STREM_HT_LINEAR, STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR);
+	table_round_trip(STREM_HT_GROUP, STREM_INDEX_FASTRANGE, STREM_SEQ_LINEAR);
+	table_round_trip(STREM_HT_ROBIN_HOOD, STREM_INDEX_MASK, STREM_SEQ_LINEAR);
+	set_round_trip(STREM_HS_LINEAR, STREM_INDEX_MODULO, STREM_SEQ_GAP);
+	set_round_trip(STREM_HS_LINEAR, STREM_INDEX_MASK, STREM_SEQ_TRIANGULAR);
+	set_round_trip(STREM_HS_GROUP, STREM_INDEX_FASTRANGE, STREM_SEQ_LINEAR);
+	set_round_trip(STREM_HS_ROBIN_HOOD, STREM_INDEX_MASK, STREM_SEQ_LINEAR);
+	corrupt_headers();
+	puts("test_snapshot: ok");
+	return 0;
+}
@@ -0,0 +1,122 @@
+// String pool: equal strings get one id whatever their length or shared prefix,
+// interned copies never move, and lines interned in batches match one by one interning.
+// Build: cc -std=c11 -I.. test_str_pool.c ../strem_*.c -lpthread && ./a.out
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strem_str_pool.h"
+#include "check.h"
+
+#define STRINGS 20000
+#define LONG_LENGTH (3 << 20)
+
+static char text[STRINGS][40];
+static size_t lengths[STRINGS];
+static uint32_t ids[STRINGS];
+static char const* copies[STRINGS];
+
+static void check_string(StremStrPool* pool, uint32_t id, char const* bytes, size_t length) {
+	size_t got_length = 0;
+	char const* const got = StremStrPool_get(pool, id, &got_length);
+	CHECK(got_length == length && memcmp(got, bytes, length) == 0 && got[length] == '\0');
+}
+
+static void intern_one_by_one(void) {
+	StremStrPool pool = StremStrPool_construct();
+	CHECK(pool.entries.content != NULL);
+
+	/* string 0 is empty, odd ones share their first STREM_STR_PREFIX bytes */
+	for(size_t i = 0; i < STRINGS; i++) {
+		const int written = snprintf(text[i], sizeof(text[i]), "%s%zu", i % 2 ? "common_prefix_" : "", i);
+		lengths[i] = i == 0 ? 0 : (size_t)written;
+		ids[i] = StremStrPool_intern(&pool, text[i], lengths[i]);
+		CHECK(ids[i] == i);
+		copies[i] = StremStrPool_get(&pool, ids[i], NULL);
+	}
+	/* copies are the pool's own */
+	const char first = text[5][0];
+	text[5][0] = '#';
+	for(size_t i = 0; i < STRINGS; i++) {
+		if(i != 5) {
+			CHECK(StremStrPool_intern(&pool, text[i], lengths[i]) == ids[i]);
+			CHECK(StremStrPool_find(&pool, text[i], lengths[i]) == ids[i]);
+		}
+	}
+	CHECK(StremStrPool_find(&pool, text[5], lengths[5]) == STREM_STR_NONE);
+	text[5][0] = first;
+
+	/* bytes past the prefix and embedded zeros tell strings apart */
+	const char zeros_a[] = { 'a', 0, 0, 0, 0, 0, 0, 0, 0, 'x' };
+	const char zeros_b[] = { 'a', 0, 0, 0, 0, 0, 0, 0, 0, 'y' };
+	const uint32_t id_a = StremStrPool_intern(&pool, zeros_a, sizeof(zeros_a));
+	const uint32_t id_b = StremStrPool_intern(&pool, zeros_b, sizeof(zeros_b));
+	CHECK(id_a != STREM_STR_NONE && id_b != STREM_STR_NONE && id_a != id_b);
+	CHECK(StremStrPool_intern(&pool, zeros_a, 1) == StremStrPool_intern(&pool, "a", 1));
+	check_string(&pool, id_b, zeros_b, sizeof(zeros_b));
+
+	/* string longer than a chunk */
+	char* const long_string = malloc(LONG_LENGTH);
+	CHECK(long_string != NULL);
+	memset(long_string, 'z', LONG_LENGTH);
+	const uint32_t long_id = StremStrPool_intern(&pool, long_string, LONG_LENGTH);
+	CHECK(long_id != STREM_STR_NONE);
+	CHECK(StremStrPool_intern(&pool, long_string, LONG_LENGTH) == long_id);
+	CHECK(StremStrPool_find(&pool, long_string, LONG_LENGTH - 1) == STREM_STR_NONE);
+	check_string(&pool, long_id, long_string, LONG_LENGTH);
+	free(long_string);
+
+	/* growing the set and arena moved none of the strings */
+	for(size_t i = 0; i < STRINGS; i++) {
+		CHECK(StremStrPool_get(&pool, ids[i], NULL) == copies[i]);
+		check_string(&pool, ids[i], text[i], lengths[i]);
+	}
+
+	StremStrPool_free(&pool);
+}
+
+static void intern_lines(void) {
+	StremStrPool pool = StremStrPool_construct();
+	StremStrPool single = StremStrPool_construct();
+	CHECK(pool.entries.content != NULL && single.entries.content != NULL);
+
+	/* every line is repeated, the last one has no newline */
+	const size_t lines = STRINGS * 2;
+	char* const buf = malloc(lines * 40);
+	CHECK(buf != NULL);
+	size_t buf_size = 0;
+	for(size_t line = 0; line < lines; line++) {
+		const size_t i = (line * 7919) % STRINGS;
+		memcpy(buf + buf_size, text[i], lengths[i]);
+		buf_size += lengths[i];
+		if(line + 1 < lines) {
+			buf[buf_size++] = '\n';
+		}
+	}
+
+	uint32_t* const line_ids = malloc(lines * sizeof(uint32_t));
+	CHECK(line_ids != NULL);
+	CHECK(StremStrPool_intern_lines(&pool, buf, buf_size, line_ids) == lines);
+	for(size_t line = 0; line < lines; line++) {
+		const size_t i = (line * 7919) % STRINGS;
+		CHECK(line_ids[line] == StremStrPool_intern(&single, text[i], lengths[i]));
+		check_string(&pool, line_ids[line], text[i], lengths[i]);
+	}
+	CHECK(pool.entries.size == single.entries.size);
+
+	/* interning again adds nothing */
+	CHECK(StremStrPool_intern_lines(&pool, buf, buf_size, NULL) == lines);
+	CHECK(pool.entries.size == single.entries.size);
+
+	free(line_ids);
+	free(buf);
+	StremStrPool_free(&pool);
+	StremStrPool_free(&single);
+}
+
+int main(void) {
+	intern_one_by_one();
+	intern_lines();
+	puts("test_str_pool: ok");
+	return 0;
+}